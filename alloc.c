@@ -0,0 +1,95 @@
+#define _GNU_SOURCE
+#include "alloc.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "magic_tables.h"
+
+static const char *alloc_kind_str[] = {
+    "MAP_HUGETLB",
+    "transparent huge pages",
+    "regular pages",
+};
+
+static size_t huge_round_up(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+// mmap `len' bytes aligned to HUGE_PAGE_SIZE by over-allocating and trimming
+// both ends, so that the whole region is eligible for transparent huge pages
+static void *mmap_aligned(size_t len) {
+    const size_t padded = len + HUGE_PAGE_SIZE;
+    uint8_t *p = mmap(0, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint8_t *aligned;
+    size_t head;
+    size_t tail;
+    if (p == MAP_FAILED) {
+	return 0;
+    }
+    aligned = (uint8_t *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    head = aligned - p;
+    tail = padded - head - len;
+    if (head) {
+	munmap(p, head);
+    }
+    if (tail) {
+	munmap(aligned + len, tail);
+    }
+    return aligned;
+}
+
+/*extern*/ void *large_alloc(size_t size, const char *name) {
+    const size_t len = huge_round_up(size);
+    void *p = MAP_FAILED;
+    int kind = ALLOC_HUGETLB;
+
+#ifndef NO_HUGE_PAGES
+    p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (p == MAP_FAILED) {
+	p = mmap_aligned(len);
+	if (!p) {
+	    fprintf(stderr, "large_alloc(%s): unable to allocate %zu bytes\n", name, size);
+	    return 0;
+	}
+	kind = ALLOC_PAGES;
+#ifndef NO_HUGE_PAGES
+	if (madvise(p, len, MADV_HUGEPAGE) == 0) {
+	    kind = ALLOC_THP;
+	}
+#endif
+    }
+
+    fprintf(stderr, "large_alloc(%s): %zu KB backed by %s\n", name, len >> 10, alloc_kind_str[kind]);
+    return p;
+}
+
+/*extern*/ void large_free(void *p, size_t size) {
+    if (p) {
+	munmap(p, huge_round_up(size));
+    }
+}
+
+/*extern*/ int alloc_init(void) {
+    #define NELEMS(x) (sizeof(x) / sizeof((x)[0]))
+    const size_t nrook = NELEMS(magic_rook_table);
+    const size_t nbishop = NELEMS(magic_bishop_table);
+    const size_t size = (nrook + nbishop) * sizeof(uint64_t);
+    uint64_t *tables = large_alloc(size, "magic tables");
+    uint64_t *rook_table = tables;
+    uint64_t *bishop_table = tables + nrook;
+    int sq;
+
+    if (!tables) {
+	return 1; // keep using the static tables
+    }
+    memcpy(rook_table, &magic_rook_table[0], nrook * sizeof(uint64_t));
+    memcpy(bishop_table, &magic_bishop_table[0], nbishop * sizeof(uint64_t));
+    for (sq = 0; sq < 64; ++sq) {
+	magic_rook_indices[sq] = rook_table + (magic_rook_indices[sq] - &magic_rook_table[0]);
+	magic_bishop_indices[sq] = bishop_table + (magic_bishop_indices[sq] - &magic_bishop_table[0]);
+    }
+    mprotect(tables, huge_round_up(size), PROT_READ);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef ALLOC__H_
+#define ALLOC__H_
+
+#include <stddef.h>
+
+// Large, randomly accessed tables (hash tables, slider attack tables) are
+// backed by huge pages when possible so lookups don't thrash the TLB:
+//   1. explicit huge pages via mmap(MAP_HUGETLB)
+//   2. transparent huge pages via madvise(MADV_HUGEPAGE) on a 2MB aligned region
+//   3. regular pages
+// Build with -DNO_HUGE_PAGES to always take 3, e.g. to benchmark the difference.
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+enum {
+    ALLOC_HUGETLB,
+    ALLOC_THP,
+    ALLOC_PAGES,
+};
+
+// `name' is only used for the log line written to stderr
+extern void *large_alloc(size_t size, const char *name);
+extern void large_free(void *p, size_t size);
+
+// Moves the magic slider attack tables into a huge page backed region.
+// Must be called before any move generation.
+extern int alloc_init(void);
+
+#endif // ALLOC__H_
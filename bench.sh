@@ -0,0 +1,12 @@
+#!/bin/sh
+# Rebuild and time perft once per set of build features, e.g.
+#   ./bench.sh 6 "" "-DNO_HUGE_PAGES" "-DCOPY_MAKE"
+# The empty string is the default build.
+
+depth=${1:-6}
+shift
+for features in "$@"; do
+    make -s clean && make -s FEATURES="$features" > /dev/null || exit 1
+    echo "FEATURES=\"$features\""
+    ./run.sh $depth
+done
@@ -0,0 +1,924 @@
+#define _GNU_SOURCE
+#include "bitbase.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "alloc.h"
+#include "movegen.h"
+#include "magic_tables.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+#define MAX_BITBASES 64
+#define BITBASE_MAGIC "BITBASE1"
+#define NAME_SIZE 8
+
+struct bitbase_header {
+    char magic[8];
+    char name[NAME_SIZE];
+    uint64_t size;
+};
+
+// `pieces' - PIECE(color, type) in index order, white is the first side
+// `material' - key of the non-king piece counts, see material_key()
+// `map' - the mmap()ed file, or the malloc()ed bits of a table generated
+//         this run
+struct bitbase {
+    char name[NAME_SIZE];
+    int npieces;
+    uint8_t pieces[BITBASE_MAX_PIECES];
+    uint32_t material;
+    uint64_t size;
+    const uint8_t *bits;
+    void *map;
+    size_t map_size;
+    int mapped;
+};
+
+static struct bitbase tables[MAX_BITBASES];
+/*extern*/ int bitbase_count;
+
+// indexed by piece type
+static const char piece_chars[] = "NBRQPK";
+static const int name_order[] = { QUEEN, ROOK, BISHOP, KNIGHT, PAWN };
+static const int piece_worth[NPIECES] = { [KNIGHT] = 3, [BISHOP] = 3, [ROOK] = 5, [QUEEN] = 9, [PAWN] = 1 };
+
+static uint32_t material_key(int counts[2][NPIECES], int flip) {
+    uint32_t key = 0;
+    int side;
+    int type;
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= PAWN; ++type) {
+	    key = key * 4 + counts[flip ? FLIP(side) : side][type];
+	}
+    }
+    return key;
+}
+
+// stronger side first
+static void material_name(int counts[2][NPIECES], char name[NAME_SIZE]) {
+    int worth[2] = {0};
+    int order[2];
+    int side;
+    int i;
+    int n;
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (i = KNIGHT; i <= PAWN; ++i) {
+	    worth[side] += counts[side][i] * piece_worth[i];
+	}
+    }
+    order[0] = worth[BLACK] > worth[WHITE] ? BLACK : WHITE;
+    order[1] = FLIP(order[0]);
+    for (side = 0; side < 2; ++side) {
+	*name++ = 'K';
+	for (i = 0; i < 5; ++i) {
+	    for (n = 0; n < counts[order[side]][name_order[i]]; ++n) {
+		*name++ = piece_chars[name_order[i]];
+	    }
+	}
+    }
+    *name = 0;
+}
+
+static int parse_name(const char *name, struct bitbase *t) {
+    int counts[2][NPIECES] = {{0}};
+    char canonical[2 * (BITBASE_MAX_PIECES + 1)];
+    const char *c;
+    int side = -1;
+    int type;
+    memset(t, 0, sizeof(*t));
+    for (c = name; *c; ++c) {
+	if (!strchr(piece_chars, *c) || t->npieces == BITBASE_MAX_PIECES) {
+	    return 1;
+	}
+	type = strchr(piece_chars, *c) - piece_chars;
+	side += type == KING;
+	if (side < 0 || side > BLACK) {
+	    return 1;
+	}
+	++counts[side][type];
+	t->pieces[t->npieces++] = PIECE(side, type);
+    }
+    if (side != BLACK || (counts[WHITE][PAWN] && counts[BLACK][PAWN])) {
+	return 1;
+    }
+    // pieces must be in the usual order, so identical ones are adjacent
+    material_name(counts, canonical);
+    if (strcmp(canonical, name) != 0) {
+	int swapped[2][NPIECES];
+	memcpy(swapped[WHITE], counts[BLACK], sizeof(swapped[WHITE]));
+	memcpy(swapped[BLACK], counts[WHITE], sizeof(swapped[BLACK]));
+	material_name(swapped, canonical);
+	if (strcmp(canonical, name) != 0) {
+	    return 1;
+	}
+    }
+    strcpy(t->name, name);
+    t->material = material_key(counts, 0);
+    t->size = 2;
+    for (type = 0; type < t->npieces; ++type) {
+	t->size *= t->pieces[type] % NPIECES == PAWN ? 48 : 64;
+    }
+    return 0;
+}
+
+static void position_counts(const struct position *restrict pos, int counts[2][NPIECES]) {
+    int side;
+    int type;
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= KING; ++type) {
+	    counts[side][type] = popcountll(PIECES(*pos, side, type));
+	}
+    }
+}
+
+// table for the material in `counts', and whether it is colour reversed
+static const struct bitbase *find_table(int counts[2][NPIECES], int *flip) {
+    const uint32_t key = material_key(counts, 0);
+    const uint32_t flipped = material_key(counts, 1);
+    int i;
+    for (i = 0; i < bitbase_count; ++i) {
+	if (tables[i].material == key || tables[i].material == flipped) {
+	    *flip = tables[i].material != key;
+	    return &tables[i];
+	}
+    }
+    return 0;
+}
+
+// With `flip' the table's first side is black in `pos': colours swap and
+// the board is mirrored top to bottom, which a byte swap does to a bitboard.
+static uint64_t encode(const struct bitbase *restrict t, const struct position *restrict pos, int flip) {
+    uint64_t idx = flip ? FLIP(pos->wtm) : pos->wtm;
+    uint64_t mult = 2;
+    uint64_t bb = 0;
+    int pc;
+    int sq;
+    int i;
+    for (i = 0; i < t->npieces; ++i) {
+	pc = t->pieces[i];
+	if (i == 0 || pc != t->pieces[i - 1]) {
+	    bb = flip ? __builtin_bswap64(pos->brd[PIECE(FLIP(PIECECOLOR(pc)), pc % NPIECES)]) : pos->brd[pc];
+	}
+	sq = lsb(bb);
+	clear_lsb(bb);
+	if (pc % NPIECES == PAWN) {
+	    idx += (sq - 8) * mult;
+	    mult *= 48;
+	} else {
+	    idx += sq * mult;
+	    mult *= 64;
+	}
+    }
+    return idx;
+}
+
+static force_inline int table_value(const struct bitbase *restrict t, uint64_t idx) {
+    return (t->bits[idx >> 2] >> ((idx & 3) * 2)) & 3;
+}
+
+/*extern*/ int bitbase_probe(const struct position *restrict pos) {
+    int counts[2][NPIECES];
+    const struct bitbase *t;
+    int flip;
+    // castling isn't in the tables either
+    if (!bitbase_count || popcountll(pos->side[WHITE] | pos->side[BLACK]) > BITBASE_MAX_PIECES ||
+	pos->castle != CSL_NONE) {
+	return BITBASE_NONE;
+    }
+    position_counts(pos, counts);
+    t = find_table(counts, &flip);
+    return t ? table_value(t, encode(t, pos, flip)) : BITBASE_NONE;
+}
+
+static int add_table(const struct bitbase *restrict t) {
+    if (bitbase_count == MAX_BITBASES) {
+	fprintf(stderr, "bitbase: too many tables, ignoring %s\n", t->name);
+	return 1;
+    }
+    memcpy(&tables[bitbase_count++], t, sizeof(*t));
+    return 0;
+}
+
+static int load_table(const char *path) {
+    const struct bitbase_header *header;
+    struct bitbase t;
+    struct stat st;
+    void *map;
+    int fd;
+    int counts[2][NPIECES];
+    int flip;
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+	return 1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*header)) {
+	close(fd);
+	return 1;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	return 1;
+    }
+    header = map;
+    if (memcmp(header->magic, BITBASE_MAGIC, sizeof(header->magic)) != 0 ||
+	memchr(header->name, 0, NAME_SIZE) == 0 || parse_name(header->name, &t) != 0 ||
+	header->size != t.size || (size_t)st.st_size != sizeof(*header) + (t.size + 3) / 4) {
+	fprintf(stderr, "bitbase: '%s' is not a valid table\n", path);
+	munmap(map, st.st_size);
+	return 1;
+    }
+    // already generated or loaded
+    memset(counts, 0, sizeof(counts));
+    for (fd = 0; fd < t.npieces; ++fd) {
+	++counts[PIECECOLOR(t.pieces[fd])][t.pieces[fd] % NPIECES];
+    }
+    if (find_table(counts, &flip)) {
+	munmap(map, st.st_size);
+	return 0;
+    }
+    t.bits = (const uint8_t *)(header + 1);
+    t.map = map;
+    t.map_size = st.st_size;
+    t.mapped = 1;
+    if (add_table(&t) != 0) {
+	munmap(map, st.st_size);
+	return 1;
+    }
+    return 0;
+}
+
+/*extern*/ int bitbase_load(const char *dir) {
+    char path[4096];
+    struct dirent *e;
+    DIR *d = opendir(dir);
+    size_t len;
+    if (!d) {
+	return bitbase_count;
+    }
+    while ((e = readdir(d)) != 0) {
+	len = strlen(e->d_name);
+	if (len > 3 && strcmp(e->d_name + len - 3, ".bb") == 0) {
+	    snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+	    load_table(path);
+	}
+    }
+    closedir(d);
+    return bitbase_count;
+}
+
+/*extern*/ void bitbase_unload(void) {
+    int i;
+    for (i = 0; i < bitbase_count; ++i) {
+	if (tables[i].mapped) {
+	    munmap(tables[i].map, tables[i].map_size);
+	} else {
+	    free(tables[i].map);
+	}
+    }
+    memset(tables, 0, sizeof(tables));
+    bitbase_count = 0;
+}
+
+//
+// Generation
+//
+
+// Per position state while generating.  The result is in the low bits,
+// S_CUR marks positions resolved last round whose predecessors haven't
+// been updated yet, and S_NEXT those resolved this round.
+enum {
+    S_UNKNOWN   = 0,
+    S_WIN       = BITBASE_WIN,
+    S_LOSS      = BITBASE_LOSS,
+    S_DRAW      = 3,
+    S_VALUE     = 3,
+    S_INVALID   = 4,
+    S_DRAW_EXIT = 8, // a capture or promotion draws, so it can't lose
+    S_CUR       = 16,
+    S_NEXT      = 32,
+};
+
+struct generator;
+
+struct gen_worker {
+    pthread_t thread;
+    int started;
+    struct generator *g;
+    uint64_t lo;
+    uint64_t hi;
+    uint64_t resolved;
+    uint64_t mismatches;
+    // [side to move][legal, wins, draws, losses]
+    uint64_t stats[2][4];
+};
+
+// `count[i]' - moves from position `i' that stay in the table and haven't
+//              been shown to lose
+struct generator {
+    const struct bitbase *t;
+    _Atomic uint8_t *state;
+    _Atomic uint8_t *count;
+    uint8_t *bits;
+    void (*phase)(struct gen_worker *w);
+};
+
+static void put(struct position *restrict pos, int pc, int sq) {
+    pos->brd[pc] |= MASK(sq);
+    pos->side[PIECECOLOR(pc)] |= MASK(sq);
+    pos->sqtopc[sq] = pc;
+}
+
+static void take(struct position *restrict pos, int sq) {
+    const int pc = pos->sqtopc[sq];
+    pos->brd[pc] &= ~MASK(sq);
+    pos->side[PIECECOLOR(pc)] &= ~MASK(sq);
+    pos->sqtopc[sq] = EMPTY;
+}
+
+// Position at `idx', 0 if it isn't a legal one with its pieces in index
+// order.  Only the board and side to move are set up, that is all move
+// generation needs.
+static int decode(const struct bitbase *restrict t, uint64_t idx, struct position *restrict pos) {
+    int prev = -1;
+    int pc;
+    int sq;
+    int i;
+    memset(pos, 0, sizeof(*pos));
+    memset(pos->sqtopc, EMPTY, sizeof(pos->sqtopc));
+    pos->enpassant = EP_NONE;
+    pos->wtm = idx & 1;
+    idx >>= 1;
+    for (i = 0; i < t->npieces; ++i) {
+	pc = t->pieces[i];
+	if (pc % NPIECES == PAWN) {
+	    sq = idx % 48 + 8;
+	    idx /= 48;
+	} else {
+	    sq = idx % 64;
+	    idx /= 64;
+	}
+	if (pos->sqtopc[sq] != EMPTY || (i > 0 && pc == t->pieces[i - 1] && sq <= prev)) {
+	    return 0;
+	}
+	put(pos, pc, sq);
+	prev = sq;
+    }
+    return generate_checkers(pos, FLIP(pos->wtm)) == 0;
+}
+
+static void apply(const struct position *restrict pos, move m, struct position *restrict child) {
+    const int pc = pos->sqtopc[FROM(m)];
+    memcpy(child, pos, sizeof(*child));
+    if (child->sqtopc[TO(m)] != EMPTY) {
+	take(child, TO(m));
+    }
+    take(child, FROM(m));
+    put(child, FLAGS(m) == FLG_PROMO ? PIECE(pos->wtm, PROMO_PC(m)) : pc, TO(m));
+    child->wtm = FLIP(pos->wtm);
+}
+
+// a bare king against at most one minor piece
+static int insufficient(int counts[2][NPIECES]) {
+    const int n = counts[WHITE][KNIGHT] + counts[WHITE][BISHOP] + counts[WHITE][ROOK] + counts[WHITE][QUEEN] +
+	counts[WHITE][PAWN] + counts[BLACK][KNIGHT] + counts[BLACK][BISHOP] + counts[BLACK][ROOK] +
+	counts[BLACK][QUEEN] + counts[BLACK][PAWN];
+    return n == 0 || (n == 1 && counts[WHITE][KNIGHT] + counts[WHITE][BISHOP] + counts[BLACK][KNIGHT] +
+		      counts[BLACK][BISHOP] == 1);
+}
+
+// result of a capture or promotion, which leads to another table
+static int exit_value(const struct position *restrict child) {
+    int counts[2][NPIECES];
+    position_counts(child, counts);
+    return insufficient(counts) ? BITBASE_DRAW : bitbase_probe(child);
+}
+
+static void init_phase(struct gen_worker *w) {
+    struct generator *g = w->g;
+    struct position pos;
+    struct position child;
+    move moves[MAX_MOVES];
+    uint64_t idx;
+    uint8_t state;
+    int nmoves;
+    int n;
+    int v;
+    int i;
+    for (idx = w->lo; idx < w->hi; ++idx) {
+	if (!decode(g->t, idx, &pos)) {
+	    g->state[idx] = S_INVALID;
+	    continue;
+	}
+	nmoves = generate_legal_moves(&pos, &moves[0]);
+	if (nmoves == 0) {
+	    g->state[idx] = generate_checkers(&pos, pos.wtm) ? S_LOSS | S_NEXT : S_DRAW;
+	    continue;
+	}
+	state = S_UNKNOWN;
+	n = 0;
+	for (i = 0; i < nmoves; ++i) {
+	    if (pos.sqtopc[TO(moves[i])] == EMPTY && FLAGS(moves[i]) != FLG_PROMO) {
+		++n;
+		continue;
+	    }
+	    apply(&pos, moves[i], &child);
+	    v = exit_value(&child);
+	    if (v == BITBASE_LOSS) {
+		state = S_WIN | S_NEXT;
+		break;
+	    } else if (v == BITBASE_DRAW) {
+		state |= S_DRAW_EXIT;
+	    }
+	}
+	if ((state & S_VALUE) == S_UNKNOWN && n == 0) {
+	    // every move leaves the table and none of them wins
+	    state = state & S_DRAW_EXIT ? S_DRAW : S_LOSS | S_NEXT;
+	}
+	g->state[idx] = state;
+	g->count[idx] = n;
+    }
+}
+
+static void advance_phase(struct gen_worker *w) {
+    struct generator *g = w->g;
+    uint64_t idx;
+    uint8_t state;
+    w->resolved = 0;
+    for (idx = w->lo; idx < w->hi; ++idx) {
+	state = g->state[idx];
+	if (state & S_NEXT) {
+	    g->state[idx] = (state & ~S_NEXT) | S_CUR;
+	    ++w->resolved;
+	}
+    }
+}
+
+// `value' is the result at a child of position `idx'
+static void update(struct generator *restrict g, uint64_t idx, int value) {
+    uint8_t state = atomic_load_explicit(&g->state[idx], memory_order_relaxed);
+    uint8_t resolved;
+    if (state & (S_INVALID | S_VALUE)) {
+	return;
+    }
+    if (value == S_LOSS) {
+	resolved = S_WIN | S_NEXT;
+    } else if (atomic_fetch_sub_explicit(&g->count[idx], 1, memory_order_relaxed) == 1) {
+	// that was the last move that stayed in the table, and it loses too
+	resolved = state & S_DRAW_EXIT ? S_DRAW : S_LOSS | S_NEXT;
+    } else {
+	return;
+    }
+    while (!(state & (S_INVALID | S_VALUE)) &&
+	   !atomic_compare_exchange_weak_explicit(&g->state[idx], &state, state | resolved,
+						  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Un-make every move the side not to move could have made to reach the
+// position (no captures or promotions, those come from other tables) and
+// pass the result on to each predecessor.
+static void propagate_phase(struct gen_worker *w) {
+    struct generator *g = w->g;
+    struct position pos;
+    struct position prev;
+    uint64_t occupied;
+    uint64_t pcs;
+    uint64_t froms;
+    uint8_t state;
+    int side;
+    int type;
+    int from;
+    int pc;
+    int sq;
+    uint64_t idx;
+    for (idx = w->lo; idx < w->hi; ++idx) {
+	state = g->state[idx];
+	if (!(state & S_CUR)) {
+	    continue;
+	}
+	g->state[idx] = state & ~S_CUR;
+	decode(g->t, idx, &pos);
+	side = FLIP(pos.wtm);
+	occupied = pos.side[WHITE] | pos.side[BLACK];
+	pcs = pos.side[side];
+	while (pcs) {
+	    sq = lsb(pcs);
+	    clear_lsb(pcs);
+	    pc = pos.sqtopc[sq];
+	    type = pc % NPIECES;
+	    switch (type) {
+	    case KING:
+		froms = king_attacks(sq);
+		break;
+	    case KNIGHT:
+		froms = knight_attacks(sq);
+		break;
+	    case BISHOP:
+		froms = bishop_attacks(sq, occupied);
+		break;
+	    case ROOK:
+		froms = rook_attacks(sq, occupied);
+		break;
+	    case QUEEN:
+		froms = queen_attacks(sq, occupied);
+		break;
+	    default:
+		// single push back to the 2nd rank at the furthest, and double
+		// pushes back from the 4th
+		froms = 0;
+		from = side == WHITE ? sq - 8 : sq + 8;
+		if (from >= A2 && from <= H7 && !(occupied & MASK(from))) {
+		    froms |= MASK(from);
+		    from = side == WHITE ? sq - 16 : sq + 16;
+		    if ((side == WHITE ? sq >> 3 == RANK_4 : sq >> 3 == RANK_5) && !(occupied & MASK(from))) {
+			froms |= MASK(from);
+		    }
+		}
+		break;
+	    }
+	    froms &= ~occupied;
+	    while (froms) {
+		from = lsb(froms);
+		clear_lsb(froms);
+		memcpy(&prev, &pos, sizeof(prev));
+		take(&prev, sq);
+		put(&prev, pc, from);
+		prev.wtm = side;
+		update(g, encode(g->t, &prev, 0), state & S_VALUE);
+	    }
+	}
+    }
+}
+
+// anything still unknown can't be forced either way
+static void pack_phase(struct gen_worker *w) {
+    struct generator *g = w->g;
+    uint64_t idx;
+    int value;
+    memset(w->stats, 0, sizeof(w->stats));
+    for (idx = w->lo; idx < w->hi; ++idx) {
+	value = g->state[idx] & S_VALUE;
+	if (value == S_DRAW || value == S_UNKNOWN) {
+	    value = BITBASE_DRAW;
+	}
+	g->bits[idx >> 2] |= value << ((idx & 3) * 2);
+	if (!(g->state[idx] & S_INVALID)) {
+	    ++w->stats[idx & 1][0];
+	    ++w->stats[idx & 1][value == BITBASE_WIN ? 1 : value == BITBASE_DRAW ? 2 : 3];
+	}
+    }
+}
+
+// the table against one ply of search over itself and the tables it
+// depends on, and against its mirror image
+static void verify_phase(struct gen_worker *w) {
+    const struct bitbase *t = w->g->t;
+    struct position pos;
+    struct position child;
+    move moves[MAX_MOVES];
+    uint64_t idx;
+    int expected;
+    int nmoves;
+    int value;
+    int v;
+    int i;
+    w->mismatches = 0;
+    for (idx = w->lo; idx < w->hi; ++idx) {
+	value = table_value(t, idx);
+	if (!decode(t, idx, &pos)) {
+	    w->mismatches += value != BITBASE_DRAW;
+	    continue;
+	}
+	// a win if any move wins, a loss if there are moves and all lose
+	nmoves = generate_legal_moves(&pos, &moves[0]);
+	expected = nmoves == 0 ? (generate_checkers(&pos, pos.wtm) ? BITBASE_LOSS : BITBASE_DRAW) : BITBASE_LOSS;
+	for (i = 0; i < nmoves && expected != BITBASE_WIN; ++i) {
+	    apply(&pos, moves[i], &child);
+	    v = exit_value(&child);
+	    if (v == BITBASE_LOSS) {
+		expected = BITBASE_WIN;
+	    } else if (v == BITBASE_DRAW) {
+		expected = BITBASE_DRAW;
+	    }
+	}
+	// a cycle of draws would pass the one ply check, so also compare with
+	// the left-right mirror image, found by reversing the bits of each rank
+	for (i = 0; i < 12; ++i) {
+	    uint64_t bb = pos.brd[i];
+	    bb = ((bb >> 1) & 0x5555555555555555ull) | ((bb & 0x5555555555555555ull) << 1);
+	    bb = ((bb >> 2) & 0x3333333333333333ull) | ((bb & 0x3333333333333333ull) << 2);
+	    child.brd[i] = ((bb >> 4) & 0x0f0f0f0f0f0f0f0full) | ((bb & 0x0f0f0f0f0f0f0f0full) << 4);
+	}
+	child.wtm = pos.wtm;
+	w->mismatches += value != expected || value != table_value(t, encode(t, &child, 0));
+    }
+}
+
+static void *gen_thread(void *arg) {
+    struct gen_worker *w = arg;
+    w->g->phase(w);
+    return 0;
+}
+
+static void run_phase(struct generator *g, struct gen_worker *workers, int nthreads,
+		      void (*phase)(struct gen_worker *w)) {
+    int i;
+    g->phase = phase;
+    for (i = 0; i < nthreads; ++i) {
+	workers[i].started = pthread_create(&workers[i].thread, 0, gen_thread, &workers[i]) == 0;
+	if (!workers[i].started) {
+	    phase(&workers[i]);
+	}
+    }
+    for (i = 0; i < nthreads; ++i) {
+	if (workers[i].started) {
+	    pthread_join(workers[i].thread, 0);
+	}
+    }
+}
+
+static double elapsed(const struct timespec *begin) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (now.tv_sec - begin->tv_sec) + (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static int write_table(const char *dir, const struct bitbase *restrict t) {
+    struct bitbase_header header;
+    char path[4096];
+    FILE *f;
+    int ok;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+	fprintf(stderr, "bitbase: can't create '%s': %s\n", dir, strerror(errno));
+	return 1;
+    }
+    snprintf(path, sizeof(path), "%s/%s.bb", dir, t->name);
+    f = fopen(path, "wb");
+    if (!f) {
+	fprintf(stderr, "bitbase: can't write '%s': %s\n", path, strerror(errno));
+	return 1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BITBASE_MAGIC, sizeof(header.magic));
+    strcpy(header.name, t->name);
+    header.size = t->size;
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(t->bits, (t->size + 3) / 4, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+	fprintf(stderr, "bitbase: error writing '%s'\n", path);
+	return 1;
+    }
+    return 0;
+}
+
+// the wins for the pawn's side in KPK with the pawn on files a-d, with
+// either side to move, the count Stockfish's KPK bitbase checks itself with
+#define KPK_WINS 111282
+
+// Results that are known without a search:
+//   - with a lone king against pieces including a queen or rook, the
+//     stronger side wins from every position where it is to move
+//   - in KRK and KQK with the lone king to move, it draws if it is
+//     stalemated or can take the rook or queen, and loses otherwise
+//   - KPK has KPK_WINS wins on the a-d files
+static uint64_t check_known(const struct bitbase *restrict t) {
+    struct position pos;
+    uint64_t mismatches = 0;
+    uint64_t wins = 0;
+    uint64_t idx;
+    uint64_t piece;
+    int heavy = 0;
+    int expected;
+    int i;
+    if (strcmp(t->name, "KPK") == 0) {
+	for (idx = 0; idx < t->size; ++idx) {
+	    if (decode(t, idx, &pos) && (lsb(PIECES(pos, WHITE, PAWN)) & 7) < 4) {
+		wins += table_value(t, idx) == (pos.wtm == WHITE ? BITBASE_WIN : BITBASE_LOSS);
+	    }
+	}
+	if (wins != KPK_WINS) {
+	    fprintf(stderr, "bitbase: KPK has %" PRIu64 " wins on the a-d files, expected %d\n", wins, KPK_WINS);
+	    return wins > KPK_WINS ? wins - KPK_WINS : KPK_WINS - wins;
+	}
+	return 0;
+    }
+    for (i = 0; i < t->npieces; ++i) {
+	if (PIECECOLOR(t->pieces[i]) == BLACK && t->pieces[i] % NPIECES != KING) {
+	    return 0;
+	}
+	heavy |= t->pieces[i] == PIECE(WHITE, QUEEN) || t->pieces[i] == PIECE(WHITE, ROOK);
+    }
+    if (!heavy) {
+	return 0;
+    }
+    for (idx = 0; idx < t->size; ++idx) {
+	if (!decode(t, idx, &pos)) {
+	    continue;
+	}
+	if (pos.wtm == WHITE) {
+	    mismatches += table_value(t, idx) != BITBASE_WIN;
+	} else if (t->npieces == 3) {
+	    piece = pos.side[WHITE] & ~PIECES(pos, WHITE, KING);
+	    if (!has_legal_move(&pos) && !generate_checkers(&pos, BLACK)) {
+		expected = BITBASE_DRAW;
+	    } else if ((king_attacks(lsb(PIECES(pos, BLACK, KING))) & piece) &&
+		       !(king_attacks(lsb(PIECES(pos, WHITE, KING))) & piece)) {
+		expected = BITBASE_DRAW;
+	    } else {
+		expected = BITBASE_LOSS;
+	    }
+	    mismatches += table_value(t, idx) != expected;
+	}
+    }
+    return mismatches;
+}
+
+static int generate_table(const struct bitbase_options *opts, struct bitbase *restrict t) {
+    const int nthreads = opts->threads > 0 ? opts->threads : 1;
+    const size_t state_size = t->size;
+    struct gen_worker *workers;
+    struct generator g;
+    struct timespec begin;
+    uint64_t stats[2][4] = {{0}};
+    uint64_t resolved;
+    uint64_t mismatches;
+    uint64_t slice;
+    int rounds = 0;
+    int side;
+    int i;
+    int j;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    memset(&g, 0, sizeof(g));
+    g.t = t;
+    g.state = large_alloc(state_size, "bitbase state");
+    g.count = large_alloc(state_size, "bitbase move counts");
+    g.bits = calloc((t->size + 3) / 4, 1);
+    workers = calloc(nthreads, sizeof(*workers));
+    if (!g.state || !g.count || !g.bits || !workers) {
+	fprintf(stderr, "bitbase: out of memory for %s\n", t->name);
+	large_free(g.state, state_size);
+	large_free(g.count, state_size);
+	free(g.bits);
+	free(workers);
+	return 1;
+    }
+    // slices start on a byte of the packed table
+    slice = ((t->size + nthreads - 1) / nthreads + 3) & ~(uint64_t)3;
+    for (i = 0; i < nthreads; ++i) {
+	workers[i].g = &g;
+	workers[i].lo = MIN(i * slice, t->size);
+	workers[i].hi = MIN((i + 1) * slice, t->size);
+    }
+
+    run_phase(&g, workers, nthreads, init_phase);
+    for (;;) {
+	run_phase(&g, workers, nthreads, advance_phase);
+	for (resolved = 0, i = 0; i < nthreads; ++i) {
+	    resolved += workers[i].resolved;
+	}
+	if (resolved == 0) {
+	    break;
+	}
+	run_phase(&g, workers, nthreads, propagate_phase);
+	++rounds;
+    }
+    run_phase(&g, workers, nthreads, pack_phase);
+    for (i = 0; i < nthreads; ++i) {
+	for (side = 0; side < 2; ++side) {
+	    for (j = 0; j < 4; ++j) {
+		stats[side][j] += workers[i].stats[side][j];
+	    }
+	}
+    }
+    large_free(g.state, state_size);
+    large_free(g.count, state_size);
+
+    t->bits = g.bits;
+    t->map = g.bits;
+    t->mapped = 0;
+    if (add_table(t) != 0) {
+	free(g.bits);
+	free(workers);
+	return 1;
+    }
+
+    printf("%s: %" PRIu64 " indices, %d rounds, %.2f s, %.1f MB working memory, %.1f MB table\n",
+	   t->name, t->size, rounds, elapsed(&begin), 2.0 * state_size / (1 << 20),
+	   (t->size + 3) / 4.0 / (1 << 20));
+    for (side = 0; side < 2; ++side) {
+	printf("  %s to move: %" PRIu64 " legal, %" PRIu64 " wins, %" PRIu64 " draws, %" PRIu64 " losses\n",
+	       side == 0 ? "first side" : "second side", stats[side][0], stats[side][1], stats[side][2],
+	       stats[side][3]);
+    }
+
+    if (opts->verify) {
+	run_phase(&g, workers, nthreads, verify_phase);
+	for (mismatches = 0, i = 0; i < nthreads; ++i) {
+	    mismatches += workers[i].mismatches;
+	}
+	mismatches += check_known(t);
+	printf("  verify: %s (%" PRIu64 " mismatches)\n", mismatches ? "FAILED" : "ok", mismatches);
+	if (mismatches) {
+	    free(workers);
+	    return 1;
+	}
+    }
+    free(workers);
+    return write_table(opts->dir, t);
+}
+
+static void material_counts(const struct bitbase *restrict t, int counts[2][NPIECES]) {
+    int i;
+    memset(counts, 0, sizeof(int[2][NPIECES]));
+    for (i = 0; i < t->npieces; ++i) {
+	++counts[PIECECOLOR(t->pieces[i])][t->pieces[i] % NPIECES];
+    }
+}
+
+// Generates `name' unless it is already there, after every table a capture
+// or promotion can lead to.  With `force' a table loaded from disk is
+// generated again.
+static int ensure_table(const struct bitbase_options *opts, const char *name, int force) {
+    struct bitbase t;
+    int counts[2][NPIECES];
+    int next[2][NPIECES];
+    char dep[NAME_SIZE];
+    const struct bitbase *existing;
+    int flip;
+    int side;
+    int type;
+    int promo;
+    int i;
+    if (parse_name(name, &t) != 0) {
+	fprintf(stderr, "bitbase: '%s' isn't a table name, expected e.g. KRKP with at most %d pieces and "
+		"pawns on one side only\n", name, BITBASE_MAX_PIECES);
+	return 1;
+    }
+    material_counts(&t, counts);
+    if (insufficient(counts)) {
+	return 0;
+    }
+    existing = find_table(counts, &flip);
+    if (existing) {
+	if (!force || !existing->mapped) {
+	    return 0;
+	}
+	// overwriting a mapped file would pull it out from under us
+	i = existing - tables;
+	munmap(tables[i].map, tables[i].map_size);
+	memmove(&tables[i], &tables[i + 1], (bitbase_count - i - 1) * sizeof(tables[0]));
+	--bitbase_count;
+    }
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= PAWN; ++type) {
+	    if (!counts[side][type]) {
+		continue;
+	    }
+	    // captures
+	    memcpy(next, counts, sizeof(next));
+	    --next[side][type];
+	    material_name(next, dep);
+	    if (ensure_table(opts, dep, 0) != 0) {
+		return 1;
+	    }
+	    if (type != PAWN) {
+		continue;
+	    }
+	    for (promo = KNIGHT; promo <= QUEEN; ++promo) {
+		memcpy(next, counts, sizeof(next));
+		--next[side][PAWN];
+		++next[side][promo];
+		material_name(next, dep);
+		if (ensure_table(opts, dep, 0) != 0) {
+		    return 1;
+		}
+	    }
+	}
+    }
+    return generate_table(opts, &t);
+}
+
+/*extern*/ int bitbase_generate(const struct bitbase_options *opts) {
+    int i;
+    bitbase_unload();
+    bitbase_load(opts->dir);
+    for (i = 0; i < opts->nnames; ++i) {
+	if (ensure_table(opts, opts->names[i], 1) != 0) {
+	    return 1;
+	}
+    }
+    return 0;
+}
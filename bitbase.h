@@ -0,0 +1,55 @@
+#ifndef BITBASE__H_
+#define BITBASE__H_
+
+#include <stdint.h>
+#include "position.h"
+
+// Win/draw/loss bitbases for endings of up to four pieces, kings included,
+// made by retrograde analysis with `chess gen-bitbase'.
+//
+// A table is named by its material, the first side's pieces (a king and
+// then Q, R, B, N and P) then the second side's, e.g. "KRKP".  Positions are
+// indexed by the side to move and each piece's square in that order, pawns
+// only on ranks 2-7.  Identical pieces take their squares in increasing
+// order, so every position has exactly one index; indices that aren't a
+// legal position just read as a draw.  Each index stores 2 bits, the result
+// for the side to move.  The same table serves the colour reversed material
+// by mirroring the board.
+//
+// En passant isn't part of the index, so tables with pawns on both sides
+// aren't supported.
+//
+// Files are `<name>.bb' in a directory, and bitbase_load() maps them
+// read-only for the eval and search to probe.
+#define BITBASE_MAX_PIECES 4
+#define DEFAULT_BITBASE_DIR "bitbases"
+
+// result for the side to move, also the 2 bit codes in the tables
+enum {
+    BITBASE_DRAW,
+    BITBASE_WIN,
+    BITBASE_LOSS,
+    BITBASE_NONE, // no table for this material
+};
+
+// `names' are generated along with any tables they need that aren't in
+// `dir' yet.  `verify' checks each finished table against one ply of
+// search and its left-right mirror image.
+struct bitbase_options {
+    const char *dir;
+    char **names;
+    int nnames;
+    int threads;
+    int verify;
+};
+
+// number of tables available to bitbase_probe()
+extern int bitbase_count;
+
+extern int bitbase_generate(const struct bitbase_options *opts);
+// maps every table in `dir', returns how many there are
+extern int bitbase_load(const char *dir);
+extern void bitbase_unload(void);
+extern int bitbase_probe(const struct position *restrict pos);
+
+#endif // BITBASE__H_
@@ -0,0 +1,129 @@
+#include "endgame.h"
+#include "movegen.h"
+#include "magic_tables.h"
+#include "weights.h"
+#include "material.h"
+#include "pawns.h"
+
+#define FILE_OF(sq) ((sq) & 7)
+#define RANK_OF(sq) ((sq) >> 3)
+#define ABS(x) ((x) < 0 ? -(x) : (x))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define DARK_SQUARES 0xaa55aa55aa55aa55ull
+
+static int distance(int a, int b) {
+    return MAX(ABS(FILE_OF(a) - FILE_OF(b)), ABS(RANK_OF(a) - RANK_OF(b)));
+}
+
+// 0 in the centre, 3 on the edge
+static int edge_distance(int sq) {
+    const int f = FILE_OF(sq);
+    const int r = RANK_OF(sq);
+    return MAX(MAX(3 - f, f - 4), MAX(3 - r, r - 4));
+}
+
+static int material_eg(const struct position *restrict pos, int side) {
+    int type;
+    int value = 0;
+    for (type = KNIGHT; type <= PAWN; ++type) {
+	value += popcountll(PIECES(*pos, side, type)) * piece_value_eg[type];
+    }
+    return value;
+}
+
+// Mate with heavy pieces: all that matters is pushing the weak king to the
+// edge and bringing the strong king up behind it.
+static int eval_kxk(const struct position *restrict pos, int strong) {
+    const int wksq = lsb(PIECES(*pos, strong, KING));
+    const int bksq = lsb(PIECES(*pos, FLIP(strong), KING));
+    const int score = KNOWN_WIN + material_eg(pos, strong) +
+	20 * edge_distance(bksq) + 10 * (7 - distance(wksq, bksq));
+    return strong == WHITE ? score : -score;
+}
+
+// Bishop and knight: the king has to be driven into a corner the bishop
+// controls.
+static int eval_kbnk(const struct position *restrict pos, int strong) {
+    const int wksq = lsb(PIECES(*pos, strong, KING));
+    const int bksq = lsb(PIECES(*pos, FLIP(strong), KING));
+    const int dark = (PIECES(*pos, strong, BISHOP) & DARK_SQUARES) != 0;
+    const int corner = dark ? MIN(distance(bksq, A1), distance(bksq, H8)) :
+	MIN(distance(bksq, A8), distance(bksq, H1));
+    const int score = KNOWN_WIN + material_eg(pos, strong) +
+	30 * (7 - corner) + 10 * (7 - distance(wksq, bksq));
+    return strong == WHITE ? score : -score;
+}
+
+// King and pawn vs king by rule of thumb: the rule of the square, key
+// squares, and the rook pawn draw.  Anything not covered keeps the normal
+// pawn value and is left to search.
+static int eval_kpk(const struct position *restrict pos, int strong) {
+    // from the strong side's point of view, pawn moving up the board
+    const int flip = strong == WHITE ? 0 : 56;
+    const int wksq = lsb(PIECES(*pos, strong, KING)) ^ flip;
+    const int bksq = lsb(PIECES(*pos, FLIP(strong), KING)) ^ flip;
+    const int psq = lsb(PIECES(*pos, strong, PAWN)) ^ flip;
+    const int file = FILE_OF(psq);
+    const int rank = RANK_OF(psq);
+    const int queen = SQUARE(file, RANK_8);
+    const int strong_to_move = pos->wtm == strong;
+    const int pawn_moves = RANK_8 - rank - (rank == RANK_2);
+    int key;
+    int score = piece_value_eg[PAWN] + 10 * rank;
+    int f;
+
+    if (!strong_to_move && distance(bksq, psq) == 1 && distance(wksq, psq) > 1) {
+	// pawn falls
+	return 0;
+    }
+    if ((file == FILE_A || file == FILE_H) && distance(bksq, queen) < distance(wksq, queen) &&
+	distance(bksq, queen) <= distance(psq, queen) - 1 + !strong_to_move) {
+	// the defending king reaches the corner in time
+	return 0;
+    }
+    if (FILE_OF(wksq) != file || RANK_OF(wksq) < rank) {
+	// nothing in the pawn's way, can the defending king catch it?
+	if (distance(bksq, queen) - !strong_to_move > pawn_moves) {
+	    score += KNOWN_WIN;
+	    return strong == WHITE ? score : -score;
+	}
+    }
+    if (file != FILE_A && file != FILE_H) {
+	// key squares: two ranks ahead of the pawn, or one or two once it is
+	// past the middle, on its own and the adjacent files
+	for (f = MAX(file - 1, FILE_A); f <= MIN(file + 1, FILE_H); ++f) {
+	    for (key = rank + (rank < RANK_5 ? 2 : 1); key <= MIN(rank + 2, RANK_8); ++key) {
+		if (wksq == SQUARE(f, key)) {
+		    score += KNOWN_WIN;
+		    return strong == WHITE ? score : -score;
+		}
+	    }
+	}
+    }
+    return strong == WHITE ? score : -score;
+}
+
+// Opposite coloured bishops with pawns are very drawish unless the strong
+// side has several passed pawns.
+static int scale_opposite_bishops(const struct position *restrict pos, int strong) {
+    const uint64_t bishops = PIECES(*pos, WHITE, BISHOP) | PIECES(*pos, BLACK, BISHOP);
+    const int opposite = popcountll(bishops & DARK_SQUARES) == 1;
+    const struct pawn_entry *pawns = pawn_probe(pos);
+    if (!opposite) {
+	return SCALE_NORMAL;
+    }
+    return MIN(SCALE_NORMAL, 16 + 12 * popcountll(pawns->passed[strong]));
+}
+
+const endgame_fn endgames[NENDGAMES] = {
+    [EG_NONE] = 0,
+    [EG_KXK] = &eval_kxk,
+    [EG_KBNK] = &eval_kbnk,
+    [EG_KPK] = &eval_kpk,
+};
+
+const scale_fn scalers[NSCALERS] = {
+    [SF_NONE] = 0,
+    [SF_OPPOSITE_BISHOPS] = &scale_opposite_bishops,
+};
@@ -0,0 +1,36 @@
+#ifndef ENDGAME__H_
+#define ENDGAME__H_
+
+#include "position.h"
+
+// Evaluators for endings that the general eval gets wrong or that need
+// search to find the plan (driving the king into a corner).  Selected by
+// material in material.c and called through the tables below, `strong' is
+// the side with the extra material.
+
+// score in centipawns from white's point of view
+typedef int (*endgame_fn)(const struct position *restrict pos, int strong);
+// endgame scale factor for `strong', out of SCALE_NORMAL
+typedef int (*scale_fn)(const struct position *restrict pos, int strong);
+
+enum {
+    EG_NONE,
+    EG_KXK,  // KQK, KRK and anything else with mating material vs a bare king
+    EG_KBNK,
+    EG_KPK,
+    NENDGAMES,
+};
+
+enum {
+    SF_NONE,
+    SF_OPPOSITE_BISHOPS, // only bishops and pawns, one bishop each
+    NSCALERS,
+};
+
+// added to positions that are won with correct play
+#define KNOWN_WIN 10000
+
+extern const endgame_fn endgames[NENDGAMES];
+extern const scale_fn scalers[NSCALERS];
+
+#endif // ENDGAME__H_
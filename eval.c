@@ -1,23 +1,180 @@
 #include "eval.h"
+#include <inttypes.h>
+#include "psqt.h"
+#include "pawns.h"
+#include "material.h"
+#include "endgame.h"
+#include "mobility.h"
+#include "nnue.h"
+#include "bitbase.h"
+
+#define EVAL_CACHE_SCORE_MASK 0xffffull
+// keeps classical and network scores for the same position apart
+#define EVAL_CACHE_NNUE_SALT 0x9e3779b97f4a0000ull
+
+static _Thread_local uint64_t eval_cache[EVAL_CACHE_SIZE];
+_Thread_local struct eval_cache_stats eval_cache_stats;
+_Thread_local struct eval_lazy_stats eval_lazy_stats;
+
+// the most the terms of each later tier are expected to move the score
+#define LAZY_MARGIN_PAWNS  200
+#define LAZY_MARGIN_PIECES 250
+
+static force_inline uint64_t *eval_cache_probe(const struct position *restrict const pos, uint64_t *key) {
+    *key = (pos->hash ^ (nnue_enabled ? EVAL_CACHE_NNUE_SALT : 0)) & ~EVAL_CACHE_SCORE_MASK;
+    ++eval_cache_stats.probes;
+    return &eval_cache[pos->hash & (EVAL_CACHE_SIZE - 1)];
+}
+
+// scale the endgame part for the side that is ahead and interpolate by phase
+static int taper(const struct position *restrict const pos, const struct material_entry *restrict material,
+		 score_t score) {
+    int eg = EG(score);
+    const int strong = eg > 0 ? WHITE : BLACK;
+    int scale = material->scale[strong];
+    if (material->scaling != SF_NONE) {
+	const int s = scalers[material->scaling](pos, strong);
+	scale = s < scale ? s : scale;
+    }
+    eg = eg * scale / SCALE_NORMAL;
+    return (MG(score) * material->phase + eg * (PHASE_MAX - material->phase)) / PHASE_MAX;
+}
+
+// A known win keeps the eval's score, to make progress by, but shifted past
+// KNOWN_WIN so no ordinary position looks better.
+static int bitbase_score(const struct position *restrict const pos, const struct material_entry *restrict material,
+			 int result) {
+    const int winner = result == BITBASE_WIN ? pos->wtm : FLIP(pos->wtm);
+    int value = material->endgame != EG_NONE ? endgames[material->endgame](pos, material->strong) :
+	taper(pos, material, pos->score + material->imbalance);
+    value = winner == WHITE ? value : -value;
+    if (value < KNOWN_WIN) {
+	value = KNOWN_WIN + (value > 0 ? value : 0);
+    }
+    return winner == WHITE ? value : -value;
+}
+
+// attack sets from this thread's last mobility pass, for the position with
+// hash `attacks_hash'
+static _Thread_local struct attack_info attacks;
+static _Thread_local uint64_t attacks_hash;
+static _Thread_local int attacks_valid;
+
+// hand written eval, stopping early when the score so far is at least
+// `margin[tier]' outside (alpha, beta); `*tier' is the last tier evaluated
+static int evaluate(const struct position *restrict const pos, int alpha, int beta, int *tier) {
+    static const int margin[EVAL_NTIERS] = {
+	[EVAL_TIER_MATERIAL] = LAZY_MARGIN_PAWNS + LAZY_MARGIN_PIECES,
+	[EVAL_TIER_PAWNS] = LAZY_MARGIN_PIECES,
+    };
+    const struct material_entry *material = material_probe(pos);
+    const struct pawn_entry *pawns;
+    score_t score;
+    int value;
+
+    *tier = EVAL_TIER_PIECES;
+    if (bitbase_count) {
+	const int result = bitbase_probe(pos);
+	if (result == BITBASE_DRAW) {
+	    return 0;
+	} else if (result != BITBASE_NONE) {
+	    return bitbase_score(pos, material, result);
+	}
+    }
+    if (material->endgame != EG_NONE) {
+	return endgames[material->endgame](pos, material->strong);
+    }
+
+    // material and piece-square terms are kept up to date by make_move(),
+    // pawn structure comes from the pawn table and everything that depends
+    // only on the piece counts from the material table; piece activity is
+    // the one part computed from scratch
+    score = pos->score + material->imbalance;
+    *tier = EVAL_TIER_MATERIAL;
+    value = taper(pos, material, score);
+    if (value <= alpha - margin[*tier] || value >= beta + margin[*tier]) {
+	return value;
+    }
+
+    pawns = pawn_probe(pos);
+    score += pawns->score;
+    *tier = EVAL_TIER_PAWNS;
+    value = taper(pos, material, score);
+    if (value <= alpha - margin[*tier] || value >= beta + margin[*tier]) {
+	return value;
+    }
+
+    score += evaluate_mobility(pos, pawns, &attacks, 0);
+    attacks_hash = pos->hash;
+    attacks_valid = 1;
+    *tier = EVAL_TIER_PIECES;
+    return taper(pos, material, score);
+}
 
 /*extern*/ int eval(const struct position *restrict const pos) {
-    #define number_of_pieces(bb) __builtin_popcountll(bb)    
-    int rval = 0;
-    
-    const int wpawns = number_of_pieces(PIECES(*pos, WHITE, PAWN));
-    const int wknights = number_of_pieces(PIECES(*pos, WHITE, KNIGHT));
-    const int wbishops = number_of_pieces(PIECES(*pos, WHITE, BISHOP));
-    const int wrooks = number_of_pieces(PIECES(*pos, WHITE, ROOK));
-    const int wqueens = number_of_pieces(PIECES(*pos, WHITE, QUEEN));
-    const int bpawns = number_of_pieces(PIECES(*pos, BLACK, PAWN));
-    const int bknights = number_of_pieces(PIECES(*pos, BLACK, KNIGHT));
-    const int bbishops = number_of_pieces(PIECES(*pos, BLACK, BISHOP));
-    const int brooks = number_of_pieces(PIECES(*pos, BLACK, ROOK));
-    const int bqueens = number_of_pieces(PIECES(*pos, BLACK, QUEEN));
-
-    // basic material calculation
-    rval += wpawns + (wknights*3) + (wbishops*3) + (wrooks*5) + (wqueens*8);
-    rval -= bpawns + (bknights*3) + (bbishops*3) + (brooks*5) + (bqueens*8);
-
-    return rval;
+    uint64_t key;
+    uint64_t *e = eval_cache_probe(pos, &key);
+    int score;
+    if ((*e & ~EVAL_CACHE_SCORE_MASK) == key) {
+	++eval_cache_stats.hits;
+	return (int16_t)(*e & EVAL_CACHE_SCORE_MASK);
+    }
+    score = nnue_enabled ? nnue_evaluate(pos) : eval_classical(pos);
+    *e = key | (uint16_t)score;
+    return score;
+}
+
+/*extern*/ int eval_lazy(const struct position *restrict const pos, int alpha, int beta) {
+    uint64_t key;
+    uint64_t *e;
+    int score;
+    int tier;
+    if (nnue_enabled) {
+	return eval(pos);
+    }
+    e = eval_cache_probe(pos, &key);
+    if ((*e & ~EVAL_CACHE_SCORE_MASK) == key) {
+	++eval_cache_stats.hits;
+	return (int16_t)(*e & EVAL_CACHE_SCORE_MASK);
+    }
+    ++eval_lazy_stats.calls;
+    score = evaluate(pos, alpha, beta, &tier);
+    ++eval_lazy_stats.exits[tier];
+    if (tier == EVAL_TIER_PIECES) {
+	*e = key | (uint16_t)score;
+    }
+    return score;
+}
+
+/*extern*/ int eval_classical(const struct position *restrict const pos) {
+    int tier;
+    return evaluate(pos, NEG_INFINITI, INFINITI, &tier);
+}
+
+/*extern*/ const struct attack_info *eval_attacks(const struct position *restrict const pos) {
+    if (!attacks_valid || attacks_hash != pos->hash) {
+	evaluate_mobility(pos, pawn_probe(pos), &attacks, 0);
+	attacks_hash = pos->hash;
+	attacks_valid = 1;
+    }
+    return &attacks;
+}
+
+/*extern*/ void eval_cache_stats_print(FILE *os) {
+    fprintf(os, "eval cache: probes = %" PRIu64 ", hits = %" PRIu64 " (%.1f%%)\n",
+	    eval_cache_stats.probes, eval_cache_stats.hits,
+	    eval_cache_stats.probes ? 100.0 * eval_cache_stats.hits / eval_cache_stats.probes : 0.0);
+}
+
+/*extern*/ void eval_lazy_stats_print(FILE *os) {
+    static const char *names[EVAL_NTIERS] = {
+	[EVAL_TIER_MATERIAL] = "material", [EVAL_TIER_PAWNS] = "pawns", [EVAL_TIER_PIECES] = "complete",
+    };
+    int tier;
+    fprintf(os, "lazy eval: calls = %" PRIu64, eval_lazy_stats.calls);
+    for (tier = 0; tier < EVAL_NTIERS; ++tier) {
+	fprintf(os, ", %s = %" PRIu64 " (%.1f%%)", names[tier], eval_lazy_stats.exits[tier],
+		eval_lazy_stats.calls ? 100.0 * eval_lazy_stats.exits[tier] / eval_lazy_stats.calls : 0.0);
+    }
+    fprintf(os, "\n");
 }
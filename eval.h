@@ -1,13 +1,70 @@
 #ifndef EVAL__H_
 #define EVAL__H_
 
+#include <stdio.h>
+#include <stdint.h>
 #include "position.h"
+#include "mobility.h"
 
-#define INFINITI 1000
-#define NEG_INFINITI -1000
-#define WHITE_WIN INFINITI
-#define BLACK_WIN NEG_INFINITI
+#define INFINITI 32000
+#define NEG_INFINITI -32000
+// Being mated `ply' plies from the root scores -(MATE - ply) for the side
+// that is mated, so shorter mates score higher.  Anything past MATE_BOUND
+// is a mate score.
+#define MATE 31000
+#define MATE_BOUND (MATE - MAX_PLY)
+#define WHITE_WIN MATE
+#define BLACK_WIN (-MATE)
 
+// score in centipawns from white's point of view, from the network when one
+// is loaded (see nnue.h) and the hand written terms otherwise
 extern int eval(const struct position *restrict const pos);
+extern int eval_classical(const struct position *restrict const pos);
+
+// The attack sets of `pos' (see mobility.h), for move ordering.  A complete
+// hand written eval leaves them behind for its position; otherwise, after a
+// cache hit, a lazy exit or with the network, they're computed here.  Valid
+// until this thread's next eval or eval_attacks().
+extern const struct attack_info *eval_attacks(const struct position *restrict const pos);
+
+// Same as eval(), except that the hand written eval may stop after a cheap
+// tier once the partial score is far enough outside (alpha, beta) that the
+// remaining terms can't bring it back.  The result is then only a bound on
+// the side of the window it fell, and isn't cached.
+//
+// Tiers, in order: material and piece-square terms, pawn structure, then
+// mobility and king attacks.
+enum {
+    EVAL_TIER_MATERIAL,
+    EVAL_TIER_PAWNS,
+    EVAL_TIER_PIECES,
+    EVAL_NTIERS,
+};
+
+// `exits[tier]' - lazy evals that stopped after `tier', EVAL_TIER_PIECES
+//                 being a complete eval
+struct eval_lazy_stats {
+    uint64_t calls;
+    uint64_t exits[EVAL_NTIERS];
+};
+
+extern _Thread_local struct eval_lazy_stats eval_lazy_stats;
+
+extern int eval_lazy(const struct position *restrict const pos, int alpha, int beta);
+extern void eval_lazy_stats_print(FILE *os);
+
+// eval() results are cached per thread by `pos->hash'.  An entry is one
+// word: the upper 48 bits of the key and the score in the low 16, so a
+// lookup never sees a score paired with the wrong key.
+#define EVAL_CACHE_SIZE 16384 // entries, per thread
+
+struct eval_cache_stats {
+    uint64_t probes;
+    uint64_t hits;
+};
+
+extern _Thread_local struct eval_cache_stats eval_cache_stats;
+
+extern void eval_cache_stats_print(FILE *os);
 
 #endif // EVAL__H_
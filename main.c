@@ -8,12 +8,25 @@
 #include <signal.h>
 #include <sys/types.h>
 #include "magic_tables.h"
+#include "alloc.h"
 #include "move.h"
 #include "position.h"
 #include "movegen.h"
 #include "perft.h"
 #include "xboard.h"
 #include "search.h"
+#include "tt.h"
+#include "pawns.h"
+#include "nnue.h"
+#include "eval.h"
+#include "stack.h"
+#include "tune.h"
+#include "mate.h"
+#include "mcts.h"
+#include "bitbase.h"
+#include "syzygy.h"
+#include "polyglot.h"
+#include "pgn.h"
 
 #define CREATE_POSITION_FROM_FEN(pos, fen) do {				\
 	if (position_from_fen(&(pos), (fen)) != 0) exit(EXIT_FAILURE);	\
@@ -130,6 +143,263 @@ int check_perft() {
     return 0;
 }
 
+struct test_pgn {
+    const char *name;
+    const char *text;
+    uint64_t games;
+    uint64_t moves;
+    uint64_t bad_games;
+    const char *last; // the last move read, 0 for none
+};
+
+// replays small PGN snippets that exercise the reader's edge cases
+int check_pgn() {
+    static const struct test_pgn tests[] = {
+	{ "plain game", "[Result \"1-0\"]\n\n1. e4 e5 2. Nf3 Nc6 1-0\n", 1, 4, 0, "b8c6" },
+	{ "stray ')'", "[Result \"0-1\"]\n\n1. e4 ) e5 0-1\n", 1, 2, 0, "e7e5" },
+	{ "variations and comments",
+	  "1. e4 {a (comment} (1. d4 (1. c4) {x)} d5) e5 $1 2. Nf3; rest of line )\n2... Nc6 *\n",
+	  1, 4, 0, "b8c6" },
+	{ "castling, promotion and e.p.",
+	  "[FEN \"r3k3/8/8/3pP3/8/8/1p6/R3K2R w KQq d6 0 1\"]\n\n1. exd6 e.p. O-O-O 2. 0-0 bxa1=Q 3. Kh2 1/2-1/2\n",
+	  1, 5, 0, "g1h2" },
+	{ "pinned knight isn't ambiguous",
+	  "[FEN \"4r1k1/8/8/8/8/2N1N3/8/4K3 w - - 0 1\"]\n\n1. Nd5 *\n", 1, 1, 0, "c3d5" },
+	{ "illegal move skips the game",
+	  "1. e4 e5 2. Ke3 Nf6 0-1\n\n[Result \"1-0\"]\n\n1. d4 1-0\n", 2, 3, 1, "d2d4" },
+	{ "game without movetext", "[Event \"a\"]\n\n[Event \"b\"]\n\n1. c4 *\n", 2, 1, 0, "c2c4" },
+	{ "unterminated comment", "1. e4 { never closed", 1, 1, 0, "e2e4" },
+	{ 0, 0, 0, 0, 0, 0 },
+    };
+    const struct test_pgn *t;
+    struct pgn_iter it;
+    char last[8];
+    int failed = 0;
+    move m;
+    for (t = &tests[0]; t->name; ++t) {
+	last[0] = 0;
+	pgn_iter_init(&it, t->text, t->text + strlen(t->text));
+	while (pgn_iter_next(&it, &m)) {
+	    strcpy(last, xboard_move_print(m));
+	}
+	if (it.games != t->games || it.moves != t->moves || it.bad_games != t->bad_games ||
+	    strcmp(last, t->last ? t->last : "") != 0) {
+	    fprintf(stderr, "check_pgn: %s: games = %" PRIu64 ", moves = %" PRIu64 ", bad games = %" PRIu64
+		    ", last = '%s'\n", t->name, it.games, it.moves, it.bad_games, last);
+	    failed = 1;
+	}
+    }
+    return failed;
+}
+
+struct test_key {
+    const char *fen;
+    uint64_t key;
+};
+
+// the example keys from the Polyglot book format, which between them use the
+// keys of every piece on its starting square, all four castling rights, an
+// en passant file and the side to move
+int check_polyglot() {
+    static const struct test_key tests[] = {
+	{ "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cull },
+	{ "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ull },
+	{ "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ull },
+	{ "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ull },
+	{ "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ull },
+	{ "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ull },
+	{ "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ull },
+	{ "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ull },
+	{ "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ull },
+	{ 0, 0 },
+    };
+    const struct test_key *t;
+    struct position pos;
+    int failed = 0;
+    for (t = &tests[0]; t->fen; ++t) {
+	if (position_from_fen(&pos, t->fen) != 0) {
+	    fprintf(stderr, "check_polyglot: bad fen '%s'\n", t->fen);
+	    failed = 1;
+	} else if (polyglot_key(&pos) != t->key) {
+	    fprintf(stderr, "check_polyglot: '%s': key = %016" PRIx64 ", expected %016" PRIx64 "\n",
+		    t->fen, polyglot_key(&pos), t->key);
+	    failed = 1;
+	}
+    }
+    return failed;
+}
+
+struct syzygy_check {
+    uint64_t positions;
+    uint64_t wdl_mismatches;
+    uint64_t dtz_mismatches;
+    uint64_t steps;
+    uint64_t step_mismatches;
+};
+
+// The DTZ one ply on from the children: the fewest plies to a winning
+// zeroing move or mate when winning, the most to any zeroing move when
+// losing.  0 if a child's result doesn't fit `wdl'.
+static int dtz_from_children(struct position *restrict pos, int wdl) {
+    move moves[MAX_MOVES];
+    struct savepos sp;
+    const int nmoves = generate_legal_moves(pos, &moves[0]);
+    int best = wdl > 0 ? INT32_MAX : 0;
+    int zeroing;
+    int value;
+    int cwdl;
+    int ok = 1;
+    int i;
+    for (i = 0; i < nmoves && ok; ++i) {
+	zeroing = pos->sqtopc[TO(moves[i])] != EMPTY || pos->sqtopc[FROM(moves[i])] % NPIECES == PAWN;
+	make_move(pos, &sp, moves[i]);
+	cwdl = syzygy_probe_wdl(pos, &ok);
+	if (!has_legal_move(pos)) {
+	    value = generate_checkers(pos, pos->wtm) ? 1 : 0;
+	} else if (zeroing) {
+	    value = 1;
+	} else {
+	    value = syzygy_probe_dtz(pos, &ok);
+	    value = value < 0 ? 1 - value : value + 1;
+	}
+	undo_move(pos, &sp, moves[i]);
+	if (wdl > 0 && cwdl == -SYZYGY_WIN && value < best) {
+	    best = value;
+	} else if (wdl < 0) {
+	    ok = ok && cwdl > 0;
+	    best = value > best ? value : best;
+	}
+    }
+    return ok && best != INT32_MAX ? best : 0;
+}
+
+// Returns 1 if the position can't be probed at all, mismatches are counted
+// in `c'.
+static int syzygy_check_position(const char *fen, struct syzygy_check *restrict c, int step) {
+    struct position pos;
+    int bb;
+    int wdl;
+    int dtz;
+    int expected;
+    int ok;
+    int wdl_ok;
+    if (position_from_fen(&pos, fen) != 0 || generate_checkers(&pos, FLIP(pos.wtm)) != 0) {
+	return 0;
+    }
+    ++c->positions;
+    bb = bitbase_probe(&pos);
+    wdl = syzygy_probe_wdl(&pos, &wdl_ok);
+    dtz = syzygy_probe_dtz(&pos, &ok);
+    if (!wdl_ok || !ok || bb == BITBASE_NONE) {
+	fprintf(stderr, "check_syzygy: '%s' can't be probed\n", fen);
+	return 1;
+    }
+    // the bitbases don't know the 50 move rule
+    if (bb != (wdl > 0 ? BITBASE_WIN : wdl < 0 ? BITBASE_LOSS : BITBASE_DRAW)) {
+	if (c->wdl_mismatches++ < 10) {
+	    fprintf(stderr, "check_syzygy: '%s': wdl = %d, bitbase = %d\n", fen, wdl, bb);
+	}
+	return 0;
+    }
+    if ((dtz > 0) != (wdl > 0) || (dtz < 0) != (wdl < 0) || (abs(dtz) > 100) != (abs(wdl) == 1)) {
+	if (c->dtz_mismatches++ < 10) {
+	    fprintf(stderr, "check_syzygy: '%s': dtz = %d, wdl = %d\n", fen, dtz, wdl);
+	}
+	return 0;
+    }
+    if (!step || abs(wdl) != SYZYGY_WIN || !has_legal_move(&pos)) {
+	return 0;
+    }
+    // tables that store full moves round the DTZ up to an even number
+    ++c->steps;
+    expected = dtz_from_children(&pos, wdl);
+    if (abs(dtz) != expected && abs(dtz) != expected + 1) {
+	if (c->step_mismatches++ < 10) {
+	    fprintf(stderr, "check_syzygy: '%s': dtz = %d, from the children %d\n", fen, dtz, expected);
+	}
+    }
+    return 0;
+}
+
+// Every legal position of the material in `name', e.g. "KRKP" with the
+// first side white, probed with the tables and compared with the bitbase
+// for WDL, and for DTZ with its WDL and with a search of one ply on every
+// `step_every'th position.
+int check_syzygy(const char *name, int step_every) {
+    static const char white_chars[] = "NBRQPK";
+    static const char black_chars[] = "nbrqpk";
+    struct syzygy_check c = {0};
+    char pieces[BITBASE_MAX_PIECES];
+    int sqs[BITBASE_MAX_PIECES];
+    char board[64];
+    char fen[96];
+    char *p;
+    uint64_t idx;
+    uint64_t size = 1;
+    uint64_t rest;
+    int npieces = 0;
+    int side = -1;
+    int empty;
+    int failed = 0;
+    int sq;
+    int i;
+    for (i = 0; name[i]; ++i) {
+	if (!strchr(white_chars, name[i]) || npieces == BITBASE_MAX_PIECES) {
+	    fprintf(stderr, "check_syzygy: bad name '%s'\n", name);
+	    return 1;
+	}
+	side += name[i] == 'K';
+	pieces[npieces++] = side == WHITE ? name[i] : black_chars[strchr(white_chars, name[i]) - white_chars];
+	size *= name[i] == 'P' ? 48 : 64;
+    }
+    for (idx = 0; idx < size * 2 && !failed; ++idx) {
+	rest = idx / 2;
+	memset(board, 0, sizeof(board));
+	for (i = 0; i < npieces; ++i) {
+	    if (pieces[i] == 'P' || pieces[i] == 'p') {
+		sqs[i] = rest % 48 + 8;
+		rest /= 48;
+	    } else {
+		sqs[i] = rest % 64;
+		rest /= 64;
+	    }
+	    // identical pieces only in increasing order
+	    if (board[sqs[i]] || (i > 0 && pieces[i] == pieces[i - 1] && sqs[i] <= sqs[i - 1])) {
+		break;
+	    }
+	    board[sqs[i]] = pieces[i];
+	}
+	if (i < npieces) {
+	    continue;
+	}
+	p = fen;
+	for (sq = 56; sq >= 0; sq -= 8) {
+	    empty = 0;
+	    for (i = 0; i < 8; ++i) {
+		if (board[sq + i]) {
+		    if (empty) {
+			*p++ = '0' + empty;
+		    }
+		    *p++ = board[sq + i];
+		    empty = 0;
+		} else {
+		    ++empty;
+		}
+	    }
+	    if (empty) {
+		*p++ = '0' + empty;
+	    }
+	    *p++ = sq ? '/' : ' ';
+	}
+	sprintf(p, "%c - - 0 1", idx % 2 ? 'b' : 'w');
+	failed = syzygy_check_position(fen, &c, idx % step_every == 0);
+    }
+    printf("%s: %" PRIu64 " positions, wdl mismatches = %" PRIu64 ", dtz mismatches = %" PRIu64
+	   ", one ply dtz checks = %" PRIu64 ", mismatches = %" PRIu64 "\n",
+	   name, c.positions, c.wdl_mismatches, c.dtz_mismatches, c.steps, c.step_mismatches);
+    return failed || c.wdl_mismatches || c.dtz_mismatches || c.step_mismatches;
+}
+
 void time_test(int depth) {
     uint64_t nodes = 0;
     struct timespec begin;
@@ -138,14 +408,19 @@ void time_test(int depth) {
     struct position pos;
     const char *fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     position_from_fen(&pos, fen);
-    printf("Timing perft to depth %d from starting position...\n", depth);
+#ifdef COPY_MAKE
+    printf("Timing perft (copy-make) to depth %d from starting position...\n", depth);
+#else
+    printf("Timing perft (make/undo) to depth %d from starting position...\n", depth);
+#endif
 
     clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
     nodes = perft_speed(&pos, depth);
     clock_gettime(CLOCK_MONOTONIC_RAW, &end);
     dur = diff(begin, end);
-    printf("Depth %d, nodes = %" PRIu64 ", took %ld seconds %ld millis\n",
-	   depth, nodes, dur.tv_sec, dur.tv_nsec / 1000000);
+    printf("Depth %d, nodes = %" PRIu64 ", took %ld seconds %ld millis, nps = %.0f\n",
+	   depth, nodes, dur.tv_sec, dur.tv_nsec / 1000000,
+	   nodes / (dur.tv_sec + dur.tv_nsec / 1e9));
 }
 
 void test_search() {
@@ -153,12 +428,487 @@ void test_search() {
     const char *fen = "r1bqkbnr/pppppppp/8/8/1n1PP3/2N5/PPP2PPP/R1BQKBNR b KQkq - 2 3";
     position_from_fen(&pos, fen);
     printf("Searching from starting position...\n");
-    move m = search(&pos);
+    move m = search(&pos, 0, 0, DEFAULT_SEARCH_DEPTH);
     move_print(m);
     printf("Done.\n");
 }
 
+static const char *bench_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    0
+};
+
+void bench_search(int depth, size_t hash_mb) {
+    const char **fen;
+    struct position pos;
+    struct timespec begin, end, dur;
+    uint64_t nodes = 0;
+    uint64_t start;
+    double secs = 0;
+
+    if (tt_init(hash_mb) != 0) {
+	fprintf(stderr, "Unable to allocate %zu MB hash table\n", hash_mb);
+	return;
+    }
+    printf("Benchmarking search to depth %d with %zu MB hash...\n", depth, hash_mb);
+    memset(&tt_stats, 0, sizeof(tt_stats));
+    memset(&search_stats, 0, sizeof(search_stats));
+    memset(&pawn_stats, 0, sizeof(pawn_stats));
+    memset(&eval_cache_stats, 0, sizeof(eval_cache_stats));
+    memset(&eval_lazy_stats, 0, sizeof(eval_lazy_stats));
+    for (fen = &bench_fens[0]; *fen; ++fen) {
+	CREATE_POSITION_FROM_FEN(pos, *fen);
+	tt_clear();
+	start = search_stats.nodes;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+	move m = search(&pos, 0, 0, depth);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	dur = diff(begin, end);
+	secs += dur.tv_sec + dur.tv_nsec / 1e9;
+	nodes += search_stats.nodes - start;
+	printf("%s: bestmove %s, nodes = %" PRIu64 ", took %ld seconds %ld millis\n",
+	       *fen, xboard_move_print(m), search_stats.nodes - start, dur.tv_sec, dur.tv_nsec / 1000000);
+    }
+    printf("Total nodes = %" PRIu64 ", nps = %.0f\n", nodes, nodes / secs);
+    search_stats_print(stdout);
+    tt_stats_print(stdout);
+    pawn_stats_print(stdout);
+    eval_cache_stats_print(stdout);
+    eval_lazy_stats_print(stdout);
+    if (nnue_enabled) {
+	nnue_stats_print(stdout);
+    }
+    tt_destroy();
+}
+
+// MCTS next to alpha-beta on the bench positions: playouts/sec, the tree
+// size, and whether the two pick the same move
+void bench_mcts(const struct mcts_options *opts, int depth) {
+    const char **fen;
+    struct position pos;
+    struct mcts_stats stats;
+    struct mcts_stats total;
+    int agree = 0;
+    int n = 0;
+    move m;
+    move ab;
+
+    if (tt_init(DEFAULT_HASH_MB) != 0) {
+	fprintf(stderr, "Unable to allocate %d MB hash table\n", DEFAULT_HASH_MB);
+	return;
+    }
+    printf("Benchmarking mcts with %" PRIu64 " playouts and %d threads against alpha-beta to depth %d...\n",
+	   opts->playouts, opts->threads, depth);
+    memset(&total, 0, sizeof(total));
+    for (fen = &bench_fens[0]; *fen; ++fen) {
+	CREATE_POSITION_FROM_FEN(pos, *fen);
+	tt_clear();
+	m = mcts_search(&pos, 0, 0, opts, &stats);
+	ab = search(&pos, 0, 0, depth);
+	printf("%s: mcts %s", *fen, xboard_move_print(m));
+	printf(" (visits = %" PRIu32 ", value = %.3f), alpha-beta %s, took %.3f seconds\n",
+	       stats.visits, stats.value, xboard_move_print(ab), stats.secs);
+	agree += m == ab;
+	++n;
+	total.playouts += stats.playouts;
+	total.nodes += stats.nodes;
+	total.collisions += stats.collisions;
+	total.depth = stats.depth > total.depth ? stats.depth : total.depth;
+	total.secs += stats.secs;
+	total.pool_size = stats.pool_size;
+    }
+    printf("Same move as alpha-beta in %d of %d positions\n", agree, n);
+    mcts_stats_print(stdout, &total);
+    tt_destroy();
+}
+
+// evaluate every leaf of the perft tree, the way search would see them
+static uint64_t eval_walk(struct position *restrict pos, struct frame *restrict f, int depth,
+			  int (*evaluate)(const struct position *restrict const), int64_t *sum) {
+    int i;
+    int nmoves;
+    uint64_t evals = 0;
+    if (depth == 0) {
+	*sum += evaluate(pos);
+	return 1;
+    }
+    nmoves = generate_legal_moves(pos, &f->moves[0]);
+    for (i = 0; i < nmoves; ++i) {
+	MAKE_MOVE(pos, &f->sp, f->moves[i]);
+	evals += eval_walk(NEXT_POS(pos), f + 1, depth - 1, evaluate, sum);
+	UNDO_MOVE(pos, &f->sp, f->moves[i]);
+    }
+    return evals;
+}
+
+static void bench_eval_with(const char *name, int depth, int (*evaluate)(const struct position *restrict const)) {
+    const char **fen;
+    struct position pos;
+    struct timespec begin, end, dur;
+    struct searchstack *ss = &thread_stack;
+    uint64_t evals = 0;
+    int64_t sum = 0;
+    double secs = 0;
+    for (fen = &bench_fens[0]; *fen; ++fen) {
+	CREATE_POSITION_FROM_FEN(pos, *fen);
+	struct frame *f = searchstack_reset(ss, &pos);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+	evals += eval_walk(&ss->pos[0], f, depth, evaluate, &sum);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	dur = diff(begin, end);
+	secs += dur.tv_sec + dur.tv_nsec / 1e9;
+    }
+    printf("%s: evals = %" PRIu64 ", evals/sec = %.0f, checksum = %" PRId64 "\n",
+	   name, evals, evals / secs, sum);
+}
+
+// Evals/sec of the hand written eval and, if `nnue_path' loads, the network.
+// Timings include the move generation and make/undo of the tree walk.
+void bench_eval(int depth, const char *nnue_path) {
+    printf("Benchmarking eval on the perft(%d) leaves...\n", depth);
+    bench_eval_with("classical", depth, &eval_classical);
+    if (nnue_load(nnue_path) != 0) {
+	printf("nnue: unable to load '%s'\n", nnue_path);
+	return;
+    }
+    memset(&nnue_stats, 0, sizeof(nnue_stats));
+#ifdef NNUE
+    bench_eval_with("nnue (incremental)", depth, &nnue_evaluate);
+#else
+    bench_eval_with("nnue (refresh, build with -DNNUE for incremental)", depth, &nnue_evaluate);
+#endif
+    nnue_stats_print(stdout);
+    nnue_unload();
+}
+
+// replays every game in the files on one thread
+void bench_pgn(int nfiles, char **paths) {
+    struct pgn_file f;
+    struct pgn_iter it;
+    struct timespec begin, end, dur;
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t bad_games = 0;
+    size_t bytes = 0;
+    double secs;
+    move m;
+    int i;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    for (i = 0; i < nfiles; ++i) {
+	if (pgn_map(&f, paths[i]) != 0) {
+	    perror(paths[i]);
+	    continue;
+	}
+	pgn_iter_init(&it, f.map, f.map + f.size);
+	while (pgn_iter_next(&it, &m)) {
+	}
+	games += it.games;
+	moves += it.moves;
+	bad_games += it.bad_games;
+	bytes += f.size;
+	pgn_unmap(&f);
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+    dur = diff(begin, end);
+    secs = dur.tv_sec + dur.tv_nsec / 1e9;
+    printf("%" PRIu64 " games, %" PRIu64 " with a bad move, %" PRIu64 " moves in %.3f seconds, "
+	   "%.0f moves/sec, %.1f MB/sec\n", games, bad_games, moves, secs,
+	   secs > 0 ? moves / secs : 0, secs > 0 ? bytes / secs / (1 << 20) : 0);
+}
+
 int main(int argc, char **argv) {
+    alloc_init();
+
+    // `chess bench [depth] [hash MB] [nnue file]'
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+	if (argc > 4 && nnue_load(argv[4]) != 0) {
+	    fprintf(stderr, "Unable to load nnue weights from '%s'\n", argv[4]);
+	    return EXIT_FAILURE;
+	}
+	bench_search(argc > 2 ? atoi(argv[2]) : DEFAULT_SEARCH_DEPTH,
+		     argc > 3 ? (size_t)atol(argv[3]) : DEFAULT_HASH_MB);
+	nnue_unload();
+	return EXIT_SUCCESS;
+    }
+
+    // `chess tune file.epd [-o weights.c] [-t threads] [-i iterations] [-r rate]'
+    if (argc >= 3 && strcmp(argv[1], "tune") == 0) {
+	struct tune_options opts = {
+	    .epd = argv[2],
+	    .output = DEFAULT_TUNE_OUTPUT,
+	    .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+	    .iterations = DEFAULT_TUNE_ITERATIONS,
+	    .rate = DEFAULT_TUNE_RATE,
+	};
+	int i;
+	for (i = 3; i + 1 < argc; i += 2) {
+	    if (strcmp(argv[i], "-o") == 0) {
+		opts.output = argv[i + 1];
+	    } else if (strcmp(argv[i], "-t") == 0) {
+		opts.threads = atoi(argv[i + 1]);
+	    } else if (strcmp(argv[i], "-i") == 0) {
+		opts.iterations = atoi(argv[i + 1]);
+	    } else if (strcmp(argv[i], "-r") == 0) {
+		opts.rate = atof(argv[i + 1]);
+	    }
+	}
+	return tune(&opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // `chess solve-mate FEN [--max-nodes N] [-t threads] [-h hash MB]', the
+    // exit status is 0 for a mate, 1 for none and 2 if the node limit ran out
+    if (argc >= 3 && strcmp(argv[1], "solve-mate") == 0) {
+	struct mate_options opts = {
+	    .fen = argv[2],
+	    .max_nodes = DEFAULT_MATE_NODES,
+	    .threads = 1,
+	    .hash_mb = DEFAULT_MATE_HASH_MB,
+	};
+	int i;
+	for (i = 3; i + 1 < argc; i += 2) {
+	    if (strcmp(argv[i], "--max-nodes") == 0) {
+		opts.max_nodes = strtoull(argv[i + 1], 0, 10);
+	    } else if (strcmp(argv[i], "-t") == 0) {
+		opts.threads = atoi(argv[i + 1]);
+	    } else if (strcmp(argv[i], "-h") == 0) {
+		opts.hash_mb = (size_t)atol(argv[i + 1]);
+	    }
+	}
+	return solve_mate(&opts);
+    }
+
+    // `chess mcts FEN [-p playouts] [-t threads] [-m pool MB]'
+    // `chess bench-mcts [playouts] [threads] [alpha-beta depth]'
+    if ((argc >= 3 && strcmp(argv[1], "mcts") == 0) || (argc >= 2 && strcmp(argv[1], "bench-mcts") == 0)) {
+	struct mcts_options opts = {
+	    .playouts = DEFAULT_MCTS_PLAYOUTS,
+	    .threads = 1,
+	    .pool_mb = DEFAULT_MCTS_POOL_MB,
+	};
+	struct mcts_stats stats;
+	struct position pos;
+	int i;
+	if (strcmp(argv[1], "bench-mcts") == 0) {
+	    opts.playouts = argc > 2 ? strtoull(argv[2], 0, 10) : opts.playouts;
+	    opts.threads = argc > 3 ? atoi(argv[3]) : opts.threads;
+	    bench_mcts(&opts, argc > 4 ? atoi(argv[4]) : DEFAULT_SEARCH_DEPTH);
+	    return EXIT_SUCCESS;
+	}
+	for (i = 3; i + 1 < argc; i += 2) {
+	    if (strcmp(argv[i], "-p") == 0) {
+		opts.playouts = strtoull(argv[i + 1], 0, 10);
+	    } else if (strcmp(argv[i], "-t") == 0) {
+		opts.threads = atoi(argv[i + 1]);
+	    } else if (strcmp(argv[i], "-m") == 0) {
+		opts.pool_mb = (size_t)atol(argv[i + 1]);
+	    }
+	}
+	CREATE_POSITION_FROM_FEN(pos, argv[2]);
+	move m = mcts_search(&pos, 0, 0, &opts, &stats);
+	printf("bestmove %s, visits = %" PRIu32 ", value = %.3f, took %.3f seconds\n",
+	       xboard_move_print(m), stats.visits, stats.value, stats.secs);
+	mcts_stats_print(stdout, &stats);
+	return EXIT_SUCCESS;
+    }
+
+    // `chess gen-bitbase [-o dir] [-t threads] [--verify] [NAME...]', by
+    // default the tables for KPK, KRK, KQK and KRKP
+    if (argc >= 2 && strcmp(argv[1], "gen-bitbase") == 0) {
+	static char *default_names[] = { "KPK", "KRK", "KQK", "KRKP" };
+	struct bitbase_options opts = {
+	    .dir = DEFAULT_BITBASE_DIR,
+	    .names = &argv[2],
+	    .nnames = 0,
+	    .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+	    .verify = 0,
+	};
+	int i;
+	for (i = 2; i < argc; ++i) {
+	    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+		opts.dir = argv[++i];
+	    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+		opts.threads = atoi(argv[++i]);
+	    } else if (strcmp(argv[i], "--verify") == 0) {
+		opts.verify = 1;
+	    } else {
+		// names are gathered in place at the front of argv
+		opts.names[opts.nnames++] = argv[i];
+	    }
+	}
+	if (opts.nnames == 0) {
+	    opts.names = default_names;
+	    opts.nnames = sizeof(default_names) / sizeof(default_names[0]);
+	}
+	i = bitbase_generate(&opts);
+	bitbase_unload();
+	return i == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // `chess check-syzygy PATH [-d bitbase dir] [NAME...]', the tables in
+    // PATH against the bitbases, by default for KPK, KRK, KQK and KRKP
+    if (argc >= 3 && strcmp(argv[1], "check-syzygy") == 0) {
+	static char *default_names[] = { "KPK", "KRK", "KQK", "KRKP" };
+	const char *dir = DEFAULT_BITBASE_DIR;
+	char **names = &argv[3];
+	int nnames = 0;
+	int failed = 0;
+	int i;
+	for (i = 3; i < argc; ++i) {
+	    if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+		dir = argv[++i];
+	    } else {
+		names[nnames++] = argv[i];
+	    }
+	}
+	if (nnames == 0) {
+	    names = default_names;
+	    nnames = sizeof(default_names) / sizeof(default_names[0]);
+	}
+	if (syzygy_init(argv[2]) == 0) {
+	    fprintf(stderr, "no tables in '%s'\n", argv[2]);
+	    return EXIT_FAILURE;
+	}
+	if (bitbase_load(dir) == 0) {
+	    fprintf(stderr, "no bitbases in '%s', see `chess gen-bitbase'\n", dir);
+	    return EXIT_FAILURE;
+	}
+	for (i = 0; i < nnames; ++i) {
+	    // a search on every position of the 3 piece tables, a sample of
+	    // the bigger ones
+	    failed |= check_syzygy(names[i], strlen(names[i]) <= 3 ? 1 : 97);
+	}
+	bitbase_unload();
+	syzygy_free();
+	printf("%s.\n", failed ? "check syzygy failed!" : "passed");
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // `chess syzygy PATH FEN', the tablebase results for the position
+    if (argc >= 4 && strcmp(argv[1], "syzygy") == 0) {
+	struct position pos;
+	int wdl;
+	int dtz;
+	int ok;
+	move m;
+	ok = syzygy_init(argv[2]);
+	printf("%d tables, up to %d pieces\n", ok, syzygy_max_pieces);
+	CREATE_POSITION_FROM_FEN(pos, argv[3]);
+	wdl = syzygy_probe_wdl(&pos, &ok);
+	if (!ok) {
+	    printf("not in the tables\n");
+	    syzygy_free();
+	    return EXIT_FAILURE;
+	}
+	printf("wdl = %d\n", wdl);
+	dtz = syzygy_probe_dtz(&pos, &ok);
+	if (ok) {
+	    printf("dtz = %d\n", dtz);
+	}
+	m = syzygy_probe_root(&pos, &dtz);
+	if (m) {
+	    printf("bestmove %s, dtz = %d\n", xboard_move_print(m), dtz);
+	}
+	syzygy_stats_print(stdout);
+	syzygy_free();
+	return EXIT_SUCCESS;
+    }
+
+    // `chess build-book [-o book] [-t threads] [-p plies] [-m min games]
+    // [-H hash MB] PGN...'
+    if (argc >= 3 && strcmp(argv[1], "build-book") == 0) {
+	struct polyglot_build_options opts = {
+	    .files = &argv[2],
+	    .nfiles = 0,
+	    .output = DEFAULT_BOOK_FILE,
+	    .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+	    .plies = DEFAULT_BOOK_PLIES,
+	    .min_games = DEFAULT_BOOK_MIN_GAMES,
+	    .hash_mb = DEFAULT_BOOK_HASH_MB,
+	};
+	int i;
+	for (i = 2; i < argc; ++i) {
+	    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+		opts.output = argv[++i];
+	    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+		opts.threads = atoi(argv[++i]);
+	    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+		opts.plies = atoi(argv[++i]);
+	    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+		opts.min_games = atoi(argv[++i]);
+	    } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+		opts.hash_mb = strtoull(argv[++i], 0, 10);
+	    } else {
+		// files are gathered in place at the front of argv
+		opts.files[opts.nfiles++] = argv[i];
+	    }
+	}
+	if (opts.nfiles == 0) {
+	    return EXIT_FAILURE;
+	}
+	return polyglot_build(&opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // `chess book BOOK FEN', the book moves for the position
+    if (argc >= 4 && strcmp(argv[1], "book") == 0) {
+	struct position pos;
+	struct timespec begin, end, dur;
+	move moves[MAX_BOOK_MOVES];
+	uint16_t weights[MAX_BOOK_MOVES];
+	int n;
+	int i;
+	if (polyglot_open(argv[2]) != 0) {
+	    fprintf(stderr, "unable to open book '%s'\n", argv[2]);
+	    return EXIT_FAILURE;
+	}
+	CREATE_POSITION_FROM_FEN(pos, argv[3]);
+	printf("key = %016" PRIx64 "\n", polyglot_key(&pos));
+	clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+	n = polyglot_probe(&pos, moves, weights, MAX_BOOK_MOVES);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	dur = diff(begin, end);
+	for (i = 0; i < n; ++i) {
+	    printf("%s %u\n", xboard_move_print(moves[i]), weights[i]);
+	}
+	printf("%d moves in %ld us\n", n, dur.tv_sec * 1000000 + dur.tv_nsec / 1000);
+	polyglot_close();
+	return EXIT_SUCCESS;
+    }
+
+    // `chess check-polyglot', the built in Polyglot keys
+    if (argc >= 2 && strcmp(argv[1], "check-polyglot") == 0) {
+	if (check_polyglot() != 0) {
+	    printf("check polyglot failed!\n");
+	    return EXIT_FAILURE;
+	}
+	printf("passed.\n");
+	return EXIT_SUCCESS;
+    }
+
+    // `chess check-pgn', the PGN reader on known snippets
+    if (argc >= 2 && strcmp(argv[1], "check-pgn") == 0) {
+	if (check_pgn() != 0) {
+	    printf("check pgn failed!\n");
+	    return EXIT_FAILURE;
+	}
+	printf("passed.\n");
+	return EXIT_SUCCESS;
+    }
+
+    // `chess bench-pgn PGN...'
+    if (argc >= 3 && strcmp(argv[1], "bench-pgn") == 0) {
+	bench_pgn(argc - 2, &argv[2]);
+	return EXIT_SUCCESS;
+    }
+
+    // `chess bench-eval [depth] [nnue file]'
+    if (argc >= 2 && strcmp(argv[1], "bench-eval") == 0) {
+	bench_eval(argc > 2 ? atoi(argv[2]) : 4, argc > 3 ? argv[3] : DEFAULT_NNUE_FILE);
+	return EXIT_SUCCESS;
+    }
+
 #if 0
     // verify perft values on some known positions
     printf("checking perft values...\n");
@@ -0,0 +1,476 @@
+#include "mate.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "alloc.h"
+#include "move.h"
+#include "position.h"
+#include "movegen.h"
+#include "stack.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+#define DFPN_BITS 26
+#define DFPN_INF ((1u << DFPN_BITS) - 1)
+#define DFPN_BUSY_MAX 63
+// nodes a thread counts before adding them to the shared total
+#define NODE_BATCH 1024
+
+// Entries hold phi (bits 0-25), delta (26-51), how many threads are
+// searching the node (52-57) and its horizon (58-63) in `data'.  `check' is
+// the key xor `data', so an entry torn by two threads writing at once just
+// doesn't match.
+//
+// The horizon is the shallowest ply the entry holds at.  A disproof that
+// ran into MAX_PLY somewhere below the node only says there's no mate in
+// the plies that were left, so it's no use closer to the root.
+struct dfpn_entry {
+    uint64_t check;
+    uint64_t data;
+};
+
+#define DFPN_BUCKET_SIZE 4
+struct dfpn_bucket {
+    _Alignas(64) struct dfpn_entry entries[DFPN_BUCKET_SIZE];
+};
+
+static struct {
+    struct dfpn_bucket *buckets;
+    uint64_t mask;
+    size_t size; // in bytes
+} table;
+
+struct solver {
+    pthread_t thread;
+    int started;
+    const struct position *root;
+    uint64_t nodes;
+};
+
+static atomic_int stop;
+static atomic_uint_fast64_t shared_nodes;
+static uint64_t max_nodes;
+static _Thread_local uint64_t nodes;
+// hashes of the children of the node at each ply
+static _Thread_local uint64_t child_keys[MAX_PLY][MAX_MOVES];
+// Children that failed only because they repeat a position higher up the
+// current line: the ply of that position and the child's horizon, MAX_PLY
+// for the rest.  Those disproofs depend on the path so they never go in the
+// table, they last as long as the parent's mid() call.
+static _Thread_local uint8_t child_reps[MAX_PLY][MAX_MOVES];
+static _Thread_local uint8_t child_horizons[MAX_PLY][MAX_MOVES];
+
+static int table_init(size_t mb) {
+    size_t nbuckets = 1;
+    while (nbuckets * 2 * sizeof(struct dfpn_bucket) <= (mb << 20)) {
+	nbuckets *= 2;
+    }
+    table.size = nbuckets * sizeof(struct dfpn_bucket);
+    table.buckets = large_alloc(table.size, "mate table");
+    if (!table.buckets) {
+	return 1;
+    }
+    table.mask = nbuckets - 1;
+    return 0;
+}
+
+static void table_destroy(void) {
+    large_free(table.buckets, table.size);
+    memset(&table, 0, sizeof(table));
+}
+
+static force_inline uint64_t pack(uint32_t phi, uint32_t delta, uint32_t busy, int horizon) {
+    return (uint64_t)phi | (uint64_t)delta << DFPN_BITS | (uint64_t)busy << (2 * DFPN_BITS) |
+	(uint64_t)horizon << 58;
+}
+
+// an entry with a horizon below `ply' isn't found
+static int table_probe(uint64_t key, int ply, uint32_t *phi, uint32_t *delta, uint32_t *busy, int *horizon) {
+    const struct dfpn_bucket *bucket = &table.buckets[key & table.mask];
+    uint64_t data;
+    int i;
+    for (i = 0; i < DFPN_BUCKET_SIZE; ++i) {
+	data = bucket->entries[i].data;
+	if ((bucket->entries[i].check ^ data) == key && data != 0) {
+	    *horizon = data >> 58;
+	    if (*horizon > ply) {
+		return 0;
+	    }
+	    *phi = data & DFPN_INF;
+	    *delta = (data >> DFPN_BITS) & DFPN_INF;
+	    *busy = (data >> (2 * DFPN_BITS)) & DFPN_BUSY_MAX;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+// `busy' is added to the entry's count of threads searching it
+static void table_store(uint64_t key, uint32_t phi, uint32_t delta, int busy, int horizon) {
+    struct dfpn_bucket *bucket = &table.buckets[key & table.mask];
+    struct dfpn_entry *replace = &bucket->entries[0];
+    uint64_t data;
+    uint64_t work;
+    uint64_t least = UINT64_MAX;
+    int i;
+    // same position, else an empty slot, else the least promising one:
+    // solved entries have an infinite phi + delta and are kept
+    for (i = 0; i < DFPN_BUCKET_SIZE; ++i) {
+	data = bucket->entries[i].data;
+	if ((bucket->entries[i].check ^ data) == key || data == 0) {
+	    // a result that holds from any ply is final, threads unwinding
+	    // after another one solved the root would overwrite it
+	    if (data != 0 && data >> 58 == 0 && ((data & DFPN_INF) == 0 || ((data >> DFPN_BITS) & DFPN_INF) == 0) &&
+		phi != 0 && delta != 0) {
+		return;
+	    }
+	    replace = &bucket->entries[i];
+	    busy += data ? (int)((data >> (2 * DFPN_BITS)) & DFPN_BUSY_MAX) : 0;
+	    break;
+	}
+	work = (data & DFPN_INF) + ((data >> DFPN_BITS) & DFPN_INF);
+	if (work < least) {
+	    least = work;
+	    replace = &bucket->entries[i];
+	}
+    }
+    busy = MAX(0, MIN(busy, DFPN_BUSY_MAX));
+    data = pack(phi, delta, busy, horizon);
+    replace->check = key ^ data;
+    replace->data = data;
+}
+
+// The attacker is whoever is to move at the root, so even plies.  A line
+// that repeats or runs past MAX_PLY is a failure to mate, but only on that
+// line or from that deep.
+static force_inline void attacker_fails(int attacker, uint32_t *phi, uint32_t *delta) {
+    *phi = attacker ? DFPN_INF : 0;
+    *delta = attacker ? 0 : DFPN_INF;
+}
+
+// Child `i' of the node at `ply'.  `rep' is the ply of the position it
+// repeats, or MAX_PLY, and `horizon' as for the table.
+static void child_value(int ply, int i, uint64_t key, uint32_t *phi, uint32_t *delta, uint32_t *busy,
+			int *rep, int *horizon) {
+    const uint64_t *keys = thread_stack.keys;
+    int j;
+    *busy = 0;
+    *rep = child_reps[ply][i];
+    *horizon = child_horizons[ply][i];
+    if (*rep < MAX_PLY) {
+	attacker_fails(ply % 2 != 0, phi, delta);
+	return;
+    }
+    if (ply + 1 >= MAX_PLY) {
+	attacker_fails(ply % 2 != 0, phi, delta);
+	*horizon = ply + 1;
+	return;
+    }
+    for (j = ply - 1; j >= 0; j -= 2) {
+	if (keys[j] == key) {
+	    attacker_fails(ply % 2 != 0, phi, delta);
+	    *rep = j;
+	    *horizon = 0;
+	    return;
+	}
+    }
+    if (!table_probe(key, ply + 1, phi, delta, busy, horizon)) {
+	*phi = 1;
+	*delta = 1;
+	*horizon = 0;
+    }
+}
+
+// a bare king can't mate, whatever the defender has
+static int lone_king(const struct position *restrict pos, int ply) {
+    const uint64_t attacker = pos->side[ply % 2 == 0 ? pos->wtm : FLIP(pos->wtm)];
+    return (attacker & (attacker - 1)) == 0;
+}
+
+static int out_of_nodes(void) {
+    if (++nodes % NODE_BATCH == 0 &&
+	atomic_fetch_add(&shared_nodes, NODE_BATCH) + NODE_BATCH >= max_nodes && max_nodes) {
+	atomic_store(&stop, 1);
+    }
+    return atomic_load_explicit(&stop, memory_order_relaxed);
+}
+
+// Expand the node and search its children until its phi reaches `thphi'
+// or its delta `thdelta'.  At every node phi is the smallest child delta
+// and delta roughly the sum of the child phis.
+//
+// A failure to mate that rests on repeating a position above this node only
+// holds on the current line: it isn't stored, and `*rep' is set to the ply
+// of the highest such position for the parent to keep.  Otherwise `*rep' is
+// MAX_PLY.
+static void mid(struct position *restrict pos, struct frame *restrict f, int ply, uint32_t thphi, uint32_t thdelta,
+		uint8_t *rep, uint8_t *horizon) {
+    uint64_t *keys = child_keys[ply];
+    uint32_t phi = 0;
+    uint32_t delta = 0;
+    uint32_t stored_phi = 1;
+    uint32_t stored_delta = 1;
+    uint32_t cphi;
+    uint32_t cdelta;
+    uint32_t busy;
+    uint32_t eff;
+    uint32_t best_eff;
+    uint32_t max_phi;
+    uint32_t best_delta = 0;
+    uint32_t second;
+    int entered = 0;
+    int unsolved;
+    int nmoves;
+    int best;
+    int crep;
+    int chorizon;
+    // what the node's failure to mate rests on if it fails, from the
+    // children that fail
+    int fail_rep;
+    int fail_horizon;
+    int i;
+
+    *rep = MAX_PLY;
+    *horizon = 0;
+    thread_stack.keys[ply] = pos->hash;
+    if (out_of_nodes()) {
+	return;
+    }
+    if (lone_king(pos, ply)) {
+	attacker_fails(ply % 2 == 0, &phi, &delta);
+	table_store(pos->hash, phi, delta, 0, 0);
+	return;
+    }
+    nmoves = generate_legal_moves(pos, &f->moves[0]);
+    if (nmoves == 0) {
+	// mate loses for whoever is to move, stalemate only for the attacker
+	if (ply % 2 == 0 || generate_checkers(pos, pos->wtm)) {
+	    table_store(pos->hash, DFPN_INF, 0, 0, 0);
+	} else {
+	    table_store(pos->hash, 0, DFPN_INF, 0, 0);
+	}
+	return;
+    }
+    for (i = 0; i < nmoves; ++i) {
+	MAKE_MOVE(pos, &f->sp, f->moves[i]);
+	keys[i] = NEXT_POS(pos)->hash;
+	UNDO_MOVE(pos, &f->sp, f->moves[i]);
+	child_reps[ply][i] = MAX_PLY;
+	child_horizons[ply][i] = 0;
+    }
+
+    for (;;) {
+	phi = DFPN_INF;
+	delta = 0;
+	best = 0;
+	unsolved = 0;
+	best_eff = second = DFPN_INF;
+	// the attacker fails once every move does, the defender holds with
+	// any one of them, so take the one that depends on the least
+	fail_rep = ply % 2 == 0 ? MAX_PLY : -1;
+	fail_horizon = ply % 2 == 0 ? 0 : MAX_PLY;
+	for (i = 0; i < nmoves; ++i) {
+	    child_value(ply, i, keys[i], &cphi, &cdelta, &busy, &crep, &chorizon);
+	    phi = MIN(phi, cdelta);
+	    delta = MAX(delta, cphi);
+	    unsolved += cphi != 0;
+	    chorizon = MAX(0, chorizon - 1);
+	    if (ply % 2 == 0) {
+		fail_rep = MIN(fail_rep, crep);
+		fail_horizon = MAX(fail_horizon, chorizon);
+	    } else if (cdelta == 0 &&
+		       (crep > fail_rep || (crep == fail_rep && chorizon < fail_horizon))) {
+		fail_rep = crep;
+		fail_horizon = chorizon;
+	    }
+	    // children other threads are in look worse than they are
+	    eff = MIN(DFPN_INF, cdelta + busy);
+	    if (eff < best_eff) {
+		second = best_eff;
+		best_eff = eff;
+		best = i;
+		best_delta = cdelta;
+	    } else if (eff < second) {
+		second = eff;
+	    }
+	}
+	// weak proof numbers: the hardest child plus one for each other one,
+	// since a plain sum counts transposed subtrees over and over
+	max_phi = delta;
+	if (delta != 0 && delta != DFPN_INF) {
+	    delta = MIN(DFPN_INF - 1, delta + unsolved - 1);
+	}
+	if (phi >= thphi || delta >= thdelta || atomic_load_explicit(&stop, memory_order_relaxed)) {
+	    break;
+	}
+	table_store(pos->hash, phi, delta, !entered, 0);
+	stored_phi = phi;
+	stored_delta = delta;
+	entered = 1;
+
+	MAKE_MOVE(pos, &f->sp, f->moves[best]);
+	mid(NEXT_POS(pos), f + 1, ply + 1,
+	    // the child's phi only moves our delta once it is the largest
+	    thdelta >= DFPN_INF ? DFPN_INF : MIN(DFPN_INF, thdelta - delta + max_phi),
+	    // 1 + epsilon: let the child run a bit past the second best so we
+	    // don't keep switching between two, and always give it at least one
+	    // more than it has or another thread's child could stall us
+	    MAX(MIN(thphi, second + second / 4 + 1), best_delta + 1),
+	    &child_reps[ply][best], &child_horizons[ply][best]);
+	UNDO_MOVE(pos, &f->sp, f->moves[best]);
+    }
+    if ((ply % 2 == 0 ? delta : phi) != 0) {
+	table_store(pos->hash, phi, delta, -entered, 0);
+    } else if (fail_rep >= ply) {
+	// a repetition of this node is a failure from anywhere
+	table_store(pos->hash, phi, delta, -entered, fail_horizon);
+    } else {
+	*rep = fail_rep;
+	*horizon = fail_horizon;
+	if (entered) {
+	    table_store(pos->hash, stored_phi, stored_delta, -1, 0);
+	}
+    }
+}
+
+static void *solver_thread(void *arg) {
+    struct solver *s = arg;
+    struct frame *f = searchstack_reset(&thread_stack, s->root);
+    uint8_t rep;
+    uint8_t horizon;
+    nodes = 0;
+    mid(&thread_stack.pos[0], f, 0, DFPN_INF, DFPN_INF, &rep, &horizon);
+    atomic_store(&stop, 1);
+    s->nodes = nodes;
+    return 0;
+}
+
+static int proven_child(const struct position *restrict pos, int ply) {
+    uint32_t phi;
+    uint32_t delta;
+    uint32_t busy;
+    int horizon;
+    return table_probe(pos->hash, ply + 1, &phi, &delta, &busy, &horizon) && (ply % 2 == 0 ? delta : phi) == 0;
+}
+
+static int on_line(const uint64_t *keys, int n, uint64_t hash) {
+    int i;
+    for (i = 0; i < n; ++i) {
+	if (keys[i] == hash) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+// Follow the proof from the root: a mate in one if there is one, otherwise
+// any proven move that doesn't go back to a position already on the line.
+// The table only knows a position is won, not how quickly, so the line can
+// be longer than the shortest mate.
+static void print_proof(FILE *os, const struct position *restrict root) {
+    struct position pos;
+    struct savepos sp;
+    move moves[MAX_MOVES];
+    uint64_t keys[MAX_PLY];
+    move m;
+    int nmoves;
+    int ply;
+    int i;
+    memcpy(&pos, root, sizeof(pos));
+    fprintf(os, "proof:");
+    for (ply = 0; ply < MAX_PLY; ++ply) {
+	keys[ply] = pos.hash;
+	nmoves = generate_legal_moves(&pos, &moves[0]);
+	if (nmoves == 0) {
+	    fprintf(os, " #");
+	    break;
+	}
+	m = 0;
+	for (i = 0; i < nmoves; ++i) {
+	    make_move(&pos, &sp, moves[i]);
+	    // a mate in one needn't be in the table, the solver stops at it
+	    if (ply % 2 == 0 && !has_legal_move(&pos) && generate_checkers(&pos, pos.wtm)) {
+		m = moves[i];
+		undo_move(&pos, &sp, moves[i]);
+		break;
+	    }
+	    if (!m && !on_line(keys, ply + 1, pos.hash) && proven_child(&pos, ply)) {
+		m = moves[i];
+	    }
+	    undo_move(&pos, &sp, moves[i]);
+	}
+	if (!m) {
+	    // every proven move goes back onto the line: the table proved a
+	    // position on it through this one, and following it would go round
+	    fprintf(os, " ...");
+	    break;
+	}
+	fprintf(os, " %s", xboard_move_print(m));
+	make_move(&pos, &sp, m);
+    }
+    fprintf(os, "\n");
+}
+
+/*extern*/ int solve_mate(const struct mate_options *opts) {
+    struct position root;
+    struct solver solvers[opts->threads > 0 ? opts->threads : 1];
+    const int nthreads = sizeof(solvers) / sizeof(solvers[0]);
+    struct timespec begin;
+    struct timespec end;
+    uint64_t total = 0;
+    uint32_t phi = 1;
+    uint32_t delta = 1;
+    uint32_t busy;
+    int horizon;
+    double secs;
+    int result;
+    int i;
+
+    if (position_from_fen(&root, opts->fen) != 0 || validate_position(&root) != 0) {
+	fprintf(stderr, "Invalid FEN: '%s'\n", opts->fen);
+	return MATE_ERROR;
+    }
+    if (table_init(opts->hash_mb) != 0) {
+	fprintf(stderr, "Unable to allocate %zu MB mate table\n", opts->hash_mb);
+	return MATE_ERROR;
+    }
+    atomic_store(&stop, 0);
+    atomic_store(&shared_nodes, 0);
+    max_nodes = opts->max_nodes;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    memset(solvers, 0, sizeof(solvers));
+    for (i = 0; i < nthreads; ++i) {
+	solvers[i].root = &root;
+	// the main thread is solver 0
+	if (i > 0) {
+	    solvers[i].started = pthread_create(&solvers[i].thread, 0, &solver_thread, &solvers[i]) == 0;
+	}
+    }
+    solver_thread(&solvers[0]);
+    for (i = 0; i < nthreads; ++i) {
+	if (solvers[i].started) {
+	    pthread_join(solvers[i].thread, 0);
+	}
+	total += solvers[i].nodes;
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+    secs = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    table_probe(root.hash, 0, &phi, &delta, &busy, &horizon);
+    result = phi == 0 ? MATE_PROVEN : delta == 0 ? MATE_DISPROVEN : MATE_UNKNOWN;
+    printf("%s\n", result == MATE_PROVEN ? "mate" : result == MATE_DISPROVEN ? "no mate" : "unknown");
+    if (result == MATE_PROVEN) {
+	print_proof(stdout, &root);
+    } else if (result == MATE_UNKNOWN) {
+	printf("proof number = %" PRIu32 ", disproof number = %" PRIu32 "\n", phi, delta);
+    }
+    printf("nodes = %" PRIu64 ", threads = %d, took %.3f seconds, nps = %.0f\n",
+	   total, nthreads, secs, secs > 0 ? total / secs : 0.0);
+    table_destroy();
+    return result;
+}
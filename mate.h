@@ -0,0 +1,42 @@
+#ifndef MATE__H_
+#define MATE__H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Mate solver: depth-first proof-number search (df-pn) for a forced mate by
+// the side to move.
+//
+// Every node keeps a proof number (how many more leaves must be proven to
+// show a mate) and a disproof number (how many to show there is none).  They
+// are stored from the side to move's point of view as `phi' and `delta' in a
+// table of their own keyed by the zobrist hash, which threads share.  Helper
+// threads run the same search on the table; a node being searched by another
+// thread looks that much worse so they tend to spread out over the tree.
+//
+// Repetitions count as a failure to mate, and lines are cut off at MAX_PLY,
+// so "no mate" means none within MAX_PLY plies.  Neither is a property of
+// the position alone, so the table only keeps a failure that comes from a
+// repetition for as long as the repeated position is on the line, and one
+// that comes from the cutoff for nodes at least as deep.  The 50 move rule is ignored.
+// The mating line printed is a proof, not necessarily the shortest mate.
+struct mate_options {
+    const char *fen;
+    uint64_t max_nodes; // 0 = no limit
+    int threads;
+    size_t hash_mb;
+};
+
+enum {
+    MATE_PROVEN,
+    MATE_DISPROVEN,
+    MATE_UNKNOWN, // node limit reached
+    MATE_ERROR,
+};
+
+#define DEFAULT_MATE_NODES 10000000
+#define DEFAULT_MATE_HASH_MB 64
+
+extern int solve_mate(const struct mate_options *opts);
+
+#endif // MATE__H_
@@ -0,0 +1,156 @@
+#include "material.h"
+#include "movegen.h"
+#include "psqt.h"
+#include "weights.h"
+#include "endgame.h"
+
+static struct material_entry material_table[MATERIAL_TABLE_SIZE];
+static _Thread_local struct material_entry material_scratch;
+
+// piece count limits for the table, anything above is computed on demand
+static const int radix[NPIECES] = { [KNIGHT] = 3, [BISHOP] = 3, [ROOK] = 3, [QUEEN] = 2, [PAWN] = 9 };
+
+static int non_pawn_material(const int counts[NPIECES]) {
+    int type;
+    int npm = 0;
+    for (type = KNIGHT; type <= QUEEN; ++type) {
+	npm += counts[type] * piece_value_mg[type];
+    }
+    return npm;
+}
+
+static score_t imbalance(int counts[2][NPIECES], struct material_trace *restrict trace) {
+    int side;
+    int sign;
+    int bishop_pair;
+    int knight_pawns;
+    int rook_pawns;
+    score_t score = 0;
+    if (trace) {
+	trace->bishop_pair = trace->knight_pawns = trace->rook_pawns = 0;
+    }
+    for (side = WHITE; side <= BLACK; ++side) {
+	sign = side == WHITE ? 1 : -1;
+	// knights gain and rooks lose value as pawns come off
+	bishop_pair = counts[side][BISHOP] >= 2;
+	knight_pawns = counts[side][KNIGHT] * (counts[side][PAWN] - 5);
+	rook_pawns = counts[side][ROOK] * (counts[side][PAWN] - 5);
+	score += sign * (bishop_pair * S(bishop_pair_mg, bishop_pair_eg) +
+			 knight_pawns * S(knight_pawns_mg, knight_pawns_eg) +
+			 rook_pawns * S(rook_pawns_mg, rook_pawns_eg));
+	if (trace) {
+	    trace->bishop_pair += sign * bishop_pair;
+	    trace->knight_pawns += sign * knight_pawns;
+	    trace->rook_pawns += sign * rook_pawns;
+	}
+    }
+    return score;
+}
+
+static void material_compute(struct material_entry *restrict e, int counts[2][NPIECES]) {
+    int side;
+    int phase = 0;
+    int type;
+    int npm[2];
+    int weak;
+    int pieces[2];
+
+    for (side = WHITE; side <= BLACK; ++side) {
+	npm[side] = non_pawn_material(counts[side]);
+	pieces[side] = counts[side][KNIGHT] + counts[side][BISHOP] + counts[side][ROOK] + counts[side][QUEEN];
+	for (type = KNIGHT; type <= QUEEN; ++type) {
+	    phase += counts[side][type] * phase_inc[PIECE(side, type)];
+	}
+    }
+    e->imbalance = imbalance(counts, 0);
+    e->phase = phase < PHASE_MAX ? phase : PHASE_MAX;
+    e->endgame = EG_NONE;
+    e->scaling = SF_NONE;
+    e->strong = WHITE;
+
+    for (side = WHITE; side <= BLACK; ++side) {
+	weak = FLIP(side);
+	e->scale[side] = SCALE_NORMAL;
+	// without pawns a small material edge rarely wins
+	if (counts[side][PAWN] == 0 && npm[side] - npm[weak] <= piece_value_mg[BISHOP]) {
+	    e->scale[side] = npm[side] < piece_value_mg[ROOK] ? 0 : npm[weak] <= piece_value_mg[BISHOP] ? 4 : 14;
+	} else if (counts[side][PAWN] == 1 && npm[side] - npm[weak] <= piece_value_mg[BISHOP]) {
+	    e->scale[side] = 48;
+	}
+
+	if (counts[weak][PAWN] + pieces[weak] != 0) {
+	    continue;
+	}
+	// weak side has a bare king
+	if (counts[side][PAWN] == 0 && pieces[side] == 2 && counts[side][BISHOP] == 1 && counts[side][KNIGHT] == 1) {
+	    e->endgame = EG_KBNK;
+	    e->strong = side;
+	} else if (counts[side][QUEEN] + counts[side][ROOK] != 0) {
+	    e->endgame = EG_KXK;
+	    e->strong = side;
+	} else if (counts[side][PAWN] == 1 && pieces[side] == 0) {
+	    e->endgame = EG_KPK;
+	    e->strong = side;
+	}
+    }
+
+    if (pieces[WHITE] == 1 && pieces[BLACK] == 1 &&
+	counts[WHITE][BISHOP] == 1 && counts[BLACK][BISHOP] == 1) {
+	e->scaling = SF_OPPOSITE_BISHOPS;
+    }
+}
+
+__attribute__((constructor)) static void material_init(void) {
+    int counts[2][NPIECES] = {{0}};
+    int key;
+    int rest;
+    int side;
+    int type;
+    for (key = 0; key < MATERIAL_TABLE_SIZE; ++key) {
+	rest = key;
+	for (side = WHITE; side <= BLACK; ++side) {
+	    for (type = KNIGHT; type <= PAWN; ++type) {
+		counts[side][type] = rest % radix[type];
+		rest /= radix[type];
+	    }
+	}
+	material_compute(&material_table[key], counts);
+    }
+}
+
+static void material_counts(const struct position *restrict pos, int counts[2][NPIECES]) {
+    int side;
+    int type;
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= PAWN; ++type) {
+	    counts[side][type] = popcountll(pos->brd[PIECE(side, type)]);
+	}
+	counts[side][KING] = 1;
+    }
+}
+
+/*extern*/ const struct material_entry *material_probe(const struct position *restrict pos) {
+    int counts[2][NPIECES];
+    int key = 0;
+    int mul = 1;
+    int side;
+    int type;
+    material_counts(pos, counts);
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= PAWN; ++type) {
+	    if (counts[side][type] >= radix[type]) {
+		material_compute(&material_scratch, counts);
+		return &material_scratch;
+	    }
+	    key += counts[side][type] * mul;
+	    mul *= radix[type];
+	}
+    }
+    return &material_table[key];
+}
+
+/*extern*/ void material_trace(const struct position *restrict pos, struct material_trace *restrict trace) {
+    int counts[2][NPIECES];
+    material_counts(pos, counts);
+    imbalance(counts, trace);
+}
@@ -0,0 +1,46 @@
+#ifndef MATERIAL__H_
+#define MATERIAL__H_
+
+#include <stdint.h>
+#include "position.h"
+
+// Everything eval() needs that depends only on how many of each piece there
+// are, precomputed for every configuration reachable without promoting into
+// a second knight/bishop/rook or queen (rarer ones are computed on demand).
+//
+// The material key is the mixed radix number of the ten piece counts:
+//   pawns 0..8, knights/bishops/rooks 0..2, queens 0..1, white then black
+//
+// `imbalance' - score for the combination of pieces on top of their values
+// `phase'     - game phase, already clamped to PHASE_MAX
+// `scale'     - endgame scale factor to use if white/black is the side ahead,
+//               out of SCALE_NORMAL
+// `endgame'   - if not EG_NONE, `endgames[endgame]' evaluates the position
+//               on its own (see endgame.h)
+// `scaling'   - if not SF_NONE, `scalers[scaling]' gives a position
+//               dependent scale factor that replaces `scale' when lower
+// `strong'    - side the endgame or scaling function is written for
+struct material_entry {
+    score_t imbalance;
+    uint8_t phase;
+    uint8_t scale[2];
+    uint8_t endgame;
+    uint8_t scaling;
+    uint8_t strong;
+};
+
+#define SCALE_NORMAL 64
+
+#define MATERIAL_TABLE_SIZE (9 * 3 * 3 * 3 * 2 * 9 * 3 * 3 * 3 * 2)
+
+// how many times each imbalance weight applies, white minus black
+struct material_trace {
+    int8_t bishop_pair;
+    int8_t knight_pawns;
+    int8_t rook_pawns;
+};
+
+extern const struct material_entry *material_probe(const struct position *restrict pos);
+extern void material_trace(const struct position *restrict pos, struct material_trace *restrict trace);
+
+#endif // MATERIAL__H_
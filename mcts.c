@@ -0,0 +1,328 @@
+#include "mcts.h"
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "alloc.h"
+#include "movegen.h"
+#include "search.h"
+#include "stack.h"
+#include "eval.h"
+#include "weights.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+// `first' values that aren't a child index (the root is index 0, so no
+// node's children start there)
+#define MCTS_UNEXPANDED 0
+#define MCTS_EXPANDING  UINT32_MAX
+#define MCTS_TERMINAL   (UINT32_MAX - 1)
+
+// values are backed up as fixed point so they can be summed atomically
+#define MCTS_ONE 65536
+#define MCTS_CPUCT 1.5
+// first play urgency: an unvisited child is taken to be this much worse
+// than its parent
+#define MCTS_FPU_REDUCTION 0.2
+// centipawns for a factor of e in the squashed eval and in the priors
+#define MCTS_EVAL_SCALE 400.0
+#define MCTS_PRIOR_SCALE 300.0
+// leaves are evaluated by qsearch(), which needs frames of its own
+#define MCTS_MAX_DEPTH (MAX_PLY / 2)
+
+// `value' - sum of the backed up results for the side that played `m'
+// `inflight' - threads whose playout passes through the node (virtual loss)
+struct mcts_node {
+    _Atomic uint32_t first;
+    _Atomic uint32_t visits;
+    _Atomic int64_t  value;
+    _Atomic uint16_t inflight;
+    move m;
+    uint16_t nchildren;
+    float prior;
+};
+
+struct mcts_tree {
+    struct mcts_node *nodes;
+    uint32_t capacity;
+    size_t size; // in bytes
+    _Atomic uint32_t used;
+    _Atomic uint64_t playouts;
+    _Atomic uint64_t collisions;
+    _Atomic int depth;
+    uint64_t limit;
+    const struct position *root;
+    const uint64_t *history;
+    int nhistory;
+};
+
+struct mcts_worker {
+    pthread_t thread;
+    int started;
+    struct mcts_tree *tree;
+};
+
+static float move_prior(const struct position *restrict pos, move m) {
+    const int victim = FLAGS(m) == FLG_EP ? PAWN : pos->sqtopc[TO(m)] % NPIECES;
+    const int attacker = pos->sqtopc[FROM(m)] % NPIECES;
+    double score = FLAGS(m) == FLG_PROMO ? piece_value_mg[PROMO_PC(m)] : 0;
+    if (pos->sqtopc[TO(m)] != EMPTY || FLAGS(m) == FLG_EP) {
+	score += piece_value_mg[victim] - piece_value_mg[attacker] / 8;
+    }
+    return exp(score / MCTS_PRIOR_SCALE);
+}
+
+// qsearch() score for the side to move, squashed to [-1, 1]
+static double evaluate_leaf(struct position *restrict pos, int depth) {
+    const int white = pos->wtm == WHITE;
+    int score = qsearch(pos, &thread_stack.frames[depth], NEG_INFINITI, INFINITI, white, 0);
+    if (!white) {
+	score = -score;
+    }
+    if (abs(score) >= MATE_BOUND) {
+	return score > 0 ? 1.0 : -1.0;
+    }
+    return tanh(score / MCTS_EVAL_SCALE);
+}
+
+// like search's is_draw(), any repetition since the game history counts
+static int is_draw(const struct position *restrict pos, int depth) {
+    const uint64_t *keys = &thread_stack.keys[thread_stack.root + depth];
+    const int n = MIN(pos->halfmoves, thread_stack.root + depth);
+    int i;
+    if (pos->halfmoves >= 100) {
+	return 1;
+    }
+    for (i = 4; i <= n; i += 2) {
+	if (keys[-i] == pos->hash) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+// Generate the children of `node' into the pool and evaluate it.  Only the
+// thread that won the compare and swap on `first' gets here.
+static double expand(struct mcts_tree *restrict t, struct mcts_node *restrict node, struct position *restrict pos,
+		     int depth) {
+    move *moves = &thread_stack.frames[depth].moves[0];
+    struct mcts_node *child;
+    const int nmoves = generate_legal_moves(pos, moves);
+    double sum = 0;
+    uint32_t idx;
+    int i;
+    if (nmoves == 0) {
+	atomic_store_explicit(&node->first, MCTS_TERMINAL, memory_order_release);
+	return generate_checkers(pos, pos->wtm) ? -1.0 : 0.0;
+    }
+    // check first so a full pool's cursor doesn't keep climbing
+    idx = atomic_load_explicit(&t->used, memory_order_relaxed);
+    if (idx + nmoves <= t->capacity) {
+	idx = atomic_fetch_add(&t->used, nmoves);
+    }
+    if (idx + nmoves > t->capacity) {
+	// pool is full, the tree stops growing here
+	atomic_store_explicit(&node->first, MCTS_UNEXPANDED, memory_order_release);
+	return evaluate_leaf(pos, depth);
+    }
+    for (i = 0; i < nmoves; ++i) {
+	child = &t->nodes[idx + i];
+	child->m = moves[i];
+	child->prior = move_prior(pos, moves[i]);
+	sum += child->prior;
+    }
+    for (i = 0; i < nmoves; ++i) {
+	t->nodes[idx + i].prior /= sum;
+    }
+    node->nchildren = nmoves;
+    atomic_store_explicit(&node->first, idx, memory_order_release);
+    return evaluate_leaf(pos, depth);
+}
+
+// PUCT: Q + c * P * sqrt(N) / (1 + n), each thread in a child counting as
+// a lost playout
+static struct mcts_node *select_child(struct mcts_tree *restrict t, struct mcts_node *restrict node, uint32_t first) {
+    const uint32_t parent_visits = atomic_load_explicit(&node->visits, memory_order_relaxed);
+    const double sqrt_n = sqrt(MAX(1, parent_visits + atomic_load_explicit(&node->inflight, memory_order_relaxed)));
+    // from the side to move here, i.e. the opposite of the parent's value
+    const double fpu = (parent_visits ? -(double)atomic_load_explicit(&node->value, memory_order_relaxed) /
+			MCTS_ONE / parent_visits : 0.0) - MCTS_FPU_REDUCTION;
+    struct mcts_node *best = &t->nodes[first];
+    struct mcts_node *child;
+    double best_score = -INFINITY;
+    double score;
+    double q;
+    uint32_t n;
+    uint32_t vl;
+    int i;
+    for (i = 0; i < node->nchildren; ++i) {
+	child = &t->nodes[first + i];
+	n = atomic_load_explicit(&child->visits, memory_order_relaxed);
+	vl = atomic_load_explicit(&child->inflight, memory_order_relaxed);
+	if (n + vl == 0) {
+	    q = fpu;
+	} else {
+	    q = ((double)atomic_load_explicit(&child->value, memory_order_relaxed) / MCTS_ONE - vl) / (n + vl);
+	}
+	score = q + MCTS_CPUCT * child->prior * sqrt_n / (1 + n + vl);
+	if (score > best_score) {
+	    best_score = score;
+	    best = child;
+	}
+    }
+    return best;
+}
+
+static void playout(struct mcts_tree *restrict t) {
+    struct mcts_node *path[MCTS_MAX_DEPTH + 1];
+    struct position *pos = &thread_stack.pos[0];
+    struct mcts_node *node = &t->nodes[0];
+    struct frame *f = &thread_stack.frames[0];
+    uint32_t first;
+    uint32_t expected;
+    double value;
+    int depth = 0;
+    int d;
+
+    path[0] = node;
+    for (;;) {
+	first = atomic_load_explicit(&node->first, memory_order_acquire);
+	if (first == MCTS_UNEXPANDED) {
+	    expected = MCTS_UNEXPANDED;
+	    if (atomic_compare_exchange_strong(&node->first, &expected, MCTS_EXPANDING)) {
+		value = expand(t, node, pos, depth);
+		break;
+	    }
+	    first = expected;
+	}
+	if (first == MCTS_EXPANDING) {
+	    atomic_fetch_add_explicit(&t->collisions, 1, memory_order_relaxed);
+	    value = evaluate_leaf(pos, depth);
+	    break;
+	}
+	if (first == MCTS_TERMINAL) {
+	    value = generate_checkers(pos, pos->wtm) ? -1.0 : 0.0;
+	    break;
+	}
+	if (depth == MCTS_MAX_DEPTH) {
+	    value = evaluate_leaf(pos, depth);
+	    break;
+	}
+	node = select_child(t, node, first);
+	atomic_fetch_add_explicit(&node->inflight, 1, memory_order_relaxed);
+	MAKE_MOVE(pos, &f->sp, node->m);
+	pos = NEXT_POS(pos);
+	++f;
+	path[++depth] = node;
+	thread_stack.keys[thread_stack.root + depth] = pos->hash;
+	if (is_draw(pos, depth)) {
+	    value = 0;
+	    break;
+	}
+    }
+
+    if (depth > atomic_load_explicit(&t->depth, memory_order_relaxed)) {
+	atomic_store_explicit(&t->depth, depth, memory_order_relaxed);
+    }
+    // `value' is for the side to move at the leaf, nodes keep it for the
+    // side that moved into them
+    for (d = depth; d >= 0; --d) {
+	value = -value;
+	atomic_fetch_add_explicit(&path[d]->value, (int64_t)(value * MCTS_ONE), memory_order_relaxed);
+	atomic_fetch_add_explicit(&path[d]->visits, 1, memory_order_relaxed);
+	if (d > 0) {
+	    atomic_fetch_sub_explicit(&path[d]->inflight, 1, memory_order_relaxed);
+	    --f;
+	    UNDO_MOVE(&thread_stack.pos[0], &f->sp, path[d]->m);
+	}
+    }
+}
+
+static void *mcts_thread(void *arg) {
+    struct mcts_tree *t = ((struct mcts_worker *)arg)->tree;
+    searchstack_reset(&thread_stack, t->root);
+    searchstack_set_history(&thread_stack, t->history, t->nhistory);
+    while (atomic_fetch_add_explicit(&t->playouts, 1, memory_order_relaxed) < t->limit) {
+	playout(t);
+    }
+    return 0;
+}
+
+/*extern*/ move mcts_search(const struct position *restrict pos, const uint64_t *history, int nhistory,
+			    const struct mcts_options *opts, struct mcts_stats *stats) {
+    struct mcts_worker workers[opts->threads > 0 ? opts->threads : 1];
+    const int nthreads = sizeof(workers) / sizeof(workers[0]);
+    struct mcts_tree t;
+    struct mcts_node *child;
+    struct mcts_node *best = 0;
+    struct timespec begin;
+    struct timespec end;
+    uint32_t first;
+    move m;
+    int i;
+
+    memset(&t, 0, sizeof(t));
+    t.size = opts->pool_mb << 20;
+    t.capacity = MIN(t.size / sizeof(struct mcts_node), MCTS_TERMINAL);
+    // fresh anonymous mappings are already zeroed, i.e. unexpanded nodes
+    t.nodes = large_alloc(t.size, "mcts pool");
+    if (!t.nodes) {
+	return 0;
+    }
+    atomic_store(&t.used, 1);
+    t.limit = opts->playouts;
+    t.root = pos;
+    t.history = history;
+    t.nhistory = nhistory;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    memset(workers, 0, sizeof(workers));
+    for (i = 0; i < nthreads; ++i) {
+	workers[i].tree = &t;
+	if (i > 0) {
+	    workers[i].started = pthread_create(&workers[i].thread, 0, &mcts_thread, &workers[i]) == 0;
+	}
+    }
+    mcts_thread(&workers[0]);
+    for (i = 1; i < nthreads; ++i) {
+	if (workers[i].started) {
+	    pthread_join(workers[i].thread, 0);
+	}
+    }
+    clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+
+    // most visited, the usual choice since it is the least noisy
+    first = atomic_load(&t.nodes[0].first);
+    if (first != MCTS_TERMINAL && first != MCTS_UNEXPANDED) {
+	for (i = 0; i < t.nodes[0].nchildren; ++i) {
+	    child = &t.nodes[first + i];
+	    if (!best || atomic_load(&child->visits) > atomic_load(&best->visits)) {
+		best = child;
+	    }
+	}
+    }
+    if (stats) {
+	stats->playouts = MIN(atomic_load(&t.playouts), t.limit);
+	stats->nodes = MIN(atomic_load(&t.used), t.capacity);
+	stats->collisions = atomic_load(&t.collisions);
+	stats->depth = atomic_load(&t.depth);
+	stats->secs = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	stats->pool_size = t.size;
+	stats->visits = best ? atomic_load(&best->visits) : 0;
+	stats->value = best && stats->visits ? (double)atomic_load(&best->value) / MCTS_ONE / stats->visits : 0.0;
+    }
+    m = best ? best->m : 0;
+    large_free(t.nodes, t.size);
+    return m;
+}
+
+/*extern*/ void mcts_stats_print(FILE *os, const struct mcts_stats *stats) {
+    fprintf(os, "mcts: playouts = %" PRIu64 ", playouts/sec = %.0f, collisions = %" PRIu64 ", depth = %d\n",
+	    stats->playouts, stats->secs > 0 ? stats->playouts / stats->secs : 0.0, stats->collisions, stats->depth);
+    fprintf(os, "mcts: nodes = %" PRIu64 " of %zu, %zu bytes per node, %.1f MB used\n",
+	    stats->nodes, stats->pool_size / sizeof(struct mcts_node), sizeof(struct mcts_node),
+	    stats->nodes * sizeof(struct mcts_node) / (double)(1 << 20));
+}
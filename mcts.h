@@ -0,0 +1,56 @@
+#ifndef MCTS__H_
+#define MCTS__H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "move.h"
+#include "position.h"
+
+// Monte Carlo tree search with PUCT selection, an alternative to search().
+//
+// Each playout walks down the tree by the PUCT rule, expands the leaf it
+// reaches and backs up the qsearch() score of the leaf squashed to [-1, 1].
+// Priors come from the same MVV-LVA idea as alpha-beta move ordering:
+// captures and promotions get more weight than quiet moves.
+//
+// Nodes come from one pool allocated up front.  A node's children are a
+// contiguous block in the pool, claimed with an atomic bump of the pool
+// cursor, so a node is 32 bytes and there is no per node malloc().  Threads
+// share the tree:
+//   - expanding a node is a compare and swap on its `first' child index,
+//     and a thread that finds a node being expanded backs up the leaf's own
+//     eval instead of waiting
+//   - a thread walking through a node adds a virtual loss to it until its
+//     playout is backed up, so other threads try other lines
+struct mcts_options {
+    uint64_t playouts;
+    int threads;
+    size_t pool_mb;
+};
+
+// `nodes'      - nodes allocated from the pool
+// `collisions' - playouts that ended on a node another thread was expanding
+// `depth'      - deepest node reached
+struct mcts_stats {
+    uint64_t playouts;
+    uint64_t nodes;
+    uint64_t collisions;
+    int depth;
+    double secs;
+    size_t pool_size; // in bytes
+    // of the chosen move
+    uint32_t visits;
+    double value;
+};
+
+#define DEFAULT_MCTS_PLAYOUTS 20000
+#define DEFAULT_MCTS_POOL_MB 256
+
+// `history' as for search().  Returns 0 if there are no legal moves or the
+// pool can't be allocated.  `stats' may be null.
+extern move mcts_search(const struct position *restrict pos, const uint64_t *history, int nhistory,
+			const struct mcts_options *opts, struct mcts_stats *stats);
+extern void mcts_stats_print(FILE *os, const struct mcts_stats *stats);
+
+#endif // MCTS__H_
@@ -0,0 +1,90 @@
+#include "mobility.h"
+#include <string.h>
+#include "movegen.h"
+#include "magic_tables.h"
+#include "weights.h"
+
+// typical number of safe squares, so mobility is a bonus or penalty around it
+static const int mobility_base[NMOBILE] = { [KNIGHT] = 4, [BISHOP] = 6, [ROOK] = 7, [QUEEN] = 13 };
+
+static score_t evaluate_side(const struct position *restrict pos, const struct pawn_entry *restrict pawns,
+			     struct attack_info *restrict info, uint8_t side, struct mobility_trace *restrict trace) {
+    const uint8_t contra = FLIP(side);
+    const uint64_t occupied = pos->side[WHITE] | pos->side[BLACK];
+    // squares not blocked by our own pawns or king and not attacked by theirs
+    const uint64_t area = ~(PIECES(*pos, side, PAWN) | PIECES(*pos, side, KING)) & ~pawns->attacks[contra];
+    const int sign = side == WHITE ? 1 : -1;
+    int zone[NMOBILE] = {0};
+    uint64_t pcs;
+    uint64_t att;
+    score_t score = 0;
+    int type;
+    int sq;
+    int n;
+
+    info->king_attackers[side] = 0;
+    for (type = KNIGHT; type <= QUEEN; ++type) {
+	info->by_type[side][type] = 0;
+	pcs = PIECES(*pos, side, type);
+	while (pcs) {
+	    sq = lsb(pcs);
+	    switch (type) {
+	    case KNIGHT:
+		att = knight_attacks(sq);
+		break;
+	    case BISHOP:
+		att = bishop_attacks(sq, occupied);
+		break;
+	    case ROOK:
+		att = rook_attacks(sq, occupied);
+		break;
+	    default:
+		att = queen_attacks(sq, occupied);
+		break;
+	    }
+	    info->by_type[side][type] |= att;
+
+	    n = popcountll(att & area) - mobility_base[type];
+	    score += n * S(mobility_mg[type], mobility_eg[type]);
+	    if (trace) {
+		trace->mobility[type] += sign * n;
+	    }
+
+	    n = popcountll(att & info->king_zone[contra]);
+	    if (n) {
+		zone[type] += n;
+		++info->king_attackers[side];
+	    }
+	    clear_lsb(pcs);
+	}
+	info->all[side] |= info->by_type[side][type];
+    }
+
+    // a single piece near the king is rarely a threat
+    if (info->king_attackers[side] >= 2) {
+	for (type = KNIGHT; type <= QUEEN; ++type) {
+	    score += zone[type] * S(king_attack_mg[type], king_attack_eg[type]);
+	    if (trace) {
+		trace->king_attack[type] += sign * zone[type];
+	    }
+	}
+    }
+    return score;
+}
+
+/*extern*/ score_t evaluate_mobility(const struct position *restrict pos, const struct pawn_entry *restrict pawns,
+				     struct attack_info *restrict info, struct mobility_trace *restrict trace) {
+    int side;
+    int ksq;
+    if (trace) {
+	memset(trace, 0, sizeof(*trace));
+    }
+    for (side = WHITE; side <= BLACK; ++side) {
+	ksq = lsb(PIECES(*pos, side, KING));
+	info->king_zone[side] = king_attacks(ksq) | MASK(ksq);
+	info->by_type[side][PAWN] = pawns->attacks[side];
+	info->by_type[side][KING] = king_attacks(ksq);
+	info->all[side] = pawns->attacks[side] | info->by_type[side][KING];
+    }
+    return evaluate_side(pos, pawns, info, WHITE, trace) - evaluate_side(pos, pawns, info, BLACK, trace);
+}
@@ -0,0 +1,38 @@
+#ifndef MOBILITY__H_
+#define MOBILITY__H_
+
+#include <stdint.h>
+#include "position.h"
+#include "pawns.h"
+
+// Piece activity: mobility and attacks on the enemy king.  Attack sets are
+// computed once per call with the same lookups movegen.c uses and are kept
+// in `struct attack_info' so move ordering can use them without generating
+// moves.
+//
+// `by_type'       - squares attacked by each piece type, pawns and king included
+// `all'           - squares attacked by anything
+// `king_zone'     - squares around and including the king
+// `king_attackers'- pieces (not pawns or king) attacking the enemy king zone
+struct attack_info {
+    uint64_t by_type[2][NPIECES];
+    uint64_t all[2];
+    uint64_t king_zone[2];
+    uint8_t  king_attackers[2];
+};
+
+// mobility and king attack weights are indexed by piece type, KNIGHT..QUEEN
+#define NMOBILE (QUEEN + 1)
+
+// how many times each weight applies, white minus black.  Mobility is
+// counted relative to `mobility_base' so it doesn't shift the piece values.
+struct mobility_trace {
+    int8_t mobility[NMOBILE];
+    int8_t king_attack[NMOBILE];
+};
+
+// score from white's point of view, `trace' may be null
+extern score_t evaluate_mobility(const struct position *restrict pos, const struct pawn_entry *restrict pawns,
+				 struct attack_info *restrict info, struct mobility_trace *restrict trace);
+
+#endif // MOBILITY__H_
@@ -78,7 +78,7 @@ void move_print_short(move m) {
     memset(&buffer[0], 0, sizeof(buffer));
     sprintf(&buffer[0], "%s%s", sq_to_str[from], sq_to_str[to]);
     if (flags == FLG_PROMO) {
-	buffer[5] = pieces[PROMO_PC(m)];
+	buffer[4] = pieces[PROMO_PC(m)];
     }
     return &buffer[0];    
 }
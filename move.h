@@ -12,6 +12,7 @@
 #define COLORSTR(x) ((x) == WHITE ? "WHITE":"BLACK")
 #define FLIP(color) ((color)^1)
 #define MAX_MOVES 256
+#define MAX_PLY 64
 #define CSL_NONE   (0)
 #define CSL_WQSIDE (1 << 0)
 #define CSL_WKSIDE (1 << 1)
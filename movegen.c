@@ -679,3 +679,253 @@ static move *generate_castling(const struct position *const restrict pos, const
     
     return (int)(end - moves);
 }
+
+// `side's king would be attacked on `sq' with `occupied' as the blockers
+force_inline
+static int attacked_with(const struct position *const restrict pos, uint8_t side, int sq, uint64_t occupied) {
+    const uint8_t contra = FLIP(side);
+    const uint64_t queens = PIECES(*pos, contra, QUEEN);
+    return (rook_attacks(sq, occupied) & (PIECES(*pos, contra, ROOK) | queens)) ||
+        (bishop_attacks(sq, occupied) & (PIECES(*pos, contra, BISHOP) | queens)) ||
+        (knight_attacks(sq) & PIECES(*pos, contra, KNIGHT)) ||
+        (pawn_attacks(side, sq) & PIECES(*pos, contra, PAWN)) ||
+        (king_attacks(sq) & PIECES(*pos, contra, KING));
+}
+
+/*extern*/ int has_legal_move(const struct position *const restrict pos) {
+    const uint8_t side = pos->wtm;
+    const uint64_t checkers = generate_checkers(pos, side);
+    const uint64_t same = pos->side[side];
+    const uint64_t occupied = pos->side[WHITE] | pos->side[BLACK];
+    const uint64_t king = PIECES(*pos, side, KING);
+    const int ksq = lsb(king);
+    uint64_t targets;
+    uint64_t pinned;
+    uint64_t pawns;
+    uint64_t pcs;
+    uint64_t posmoves;
+    int from;
+    move moves[MAX_MOVES];
+
+    // king moves first, they don't depend on pins
+    posmoves = king_attacks(ksq) & ~same;
+    while (posmoves) {
+        if (!attacked_with(pos, side, lsb(posmoves), occupied ^ king)) {
+            return 1;
+        }
+        clear_lsb(posmoves);
+    }
+    if (more_than_one_piece(checkers)) {
+        return 0;
+    }
+
+    // then pieces that aren't pinned, which only have to reach a target
+    if (checkers) {
+        from = lsb(checkers);
+        targets = checkers;
+        if (pos->sqtopc[from] % NPIECES != KNIGHT && pos->sqtopc[from] % NPIECES != PAWN) {
+            targets |= between_sqs(from, ksq);
+        }
+    } else {
+        targets = ~same;
+    }
+    pinned = generate_pinned(pos, side, side);
+
+    pcs = PIECES(*pos, side, KNIGHT) & ~pinned;
+    while (pcs) {
+        if (knight_attacks(lsb(pcs)) & targets) {
+            return 1;
+        }
+        clear_lsb(pcs);
+    }
+    pcs = PIECES(*pos, side, BISHOP) | PIECES(*pos, side, QUEEN);
+    while (pcs) {
+        from = lsb(pcs);
+        posmoves = bishop_attacks(from, occupied) & targets;
+        if (MASK(from) & pinned) {
+            // a pinned piece can only move along the pin, and never out of check
+            posmoves = checkers ? 0 : posmoves & line_bb[ksq][from];
+        }
+        if (posmoves) {
+            return 1;
+        }
+        clear_lsb(pcs);
+    }
+    pcs = PIECES(*pos, side, ROOK) | PIECES(*pos, side, QUEEN);
+    while (pcs) {
+        from = lsb(pcs);
+        posmoves = rook_attacks(from, occupied) & targets;
+        if (MASK(from) & pinned) {
+            posmoves = checkers ? 0 : posmoves & line_bb[ksq][from];
+        }
+        if (posmoves) {
+            return 1;
+        }
+        clear_lsb(pcs);
+    }
+
+    pawns = PIECES(*pos, side, PAWN) & ~pinned;
+    posmoves = (side == WHITE ? pawns << 8 : pawns >> 8) & ~occupied;
+    if (posmoves & targets) {
+        return 1;
+    }
+    posmoves = (side == WHITE ? (posmoves & THIRD_RANK) << 8 : (posmoves & SIXTH_RANK) >> 8) & ~occupied;
+    if (posmoves & targets) {
+        return 1;
+    }
+    posmoves = side == WHITE ? ((pawns & ~A_FILE) << 7) | ((pawns & ~H_FILE) << 9) :
+        ((pawns & ~A_FILE) >> 9) | ((pawns & ~H_FILE) >> 7);
+    if (posmoves & targets & pos->side[FLIP(side)]) {
+        return 1;
+    }
+
+    // what's left is rare: pinned pawns and en passant
+    if ((PIECES(*pos, side, PAWN) & pinned) == 0 && pos->enpassant == EP_NONE) {
+        return 0;
+    }
+    return generate_legal_moves(pos, &moves[0]) != 0;
+}
+
+/*extern*/ void check_info_init(const struct position *const restrict pos, struct check_info *restrict ci) {
+    const uint8_t side = pos->wtm;
+    const uint8_t contra = FLIP(side);
+    const uint64_t occupied = pos->side[WHITE] | pos->side[BLACK];
+    const int ksq = lsb(PIECES(*pos, contra, KING));
+    ci->ksq = ksq;
+    ci->squares[KNIGHT] = knight_attacks(ksq);
+    ci->squares[BISHOP] = bishop_attacks(ksq, occupied);
+    ci->squares[ROOK] = rook_attacks(ksq, occupied);
+    ci->squares[QUEEN] = ci->squares[BISHOP] | ci->squares[ROOK];
+    ci->squares[PAWN] = pawn_attacks(contra, ksq);
+    ci->squares[KING] = 0;
+    ci->discovered = generate_pinned(pos, side, contra);
+}
+
+/*extern*/ int gives_check(const struct position *const restrict pos, const struct check_info *restrict ci, move m) {
+    const uint8_t side = pos->wtm;
+    const int from = FROM(m);
+    const int to = TO(m);
+    const int ksq = ci->ksq;
+    const uint64_t queens = PIECES(*pos, side, QUEEN);
+    uint64_t occupied;
+    int capsq;
+    int rfrom;
+    int rto;
+
+    // moving off the line between a slider and their king
+    if ((ci->discovered & MASK(from)) && !(lined_up(from, to, ksq))) {
+        return 1;
+    }
+    if (FLAGS(m) != FLG_PROMO && (ci->squares[pos->sqtopc[from] % NPIECES] & MASK(to))) {
+        return 1;
+    }
+
+    switch (FLAGS(m)) {
+    case FLG_PROMO:
+        // the pawn's own square may have been the only blocker
+        occupied = (pos->side[WHITE] | pos->side[BLACK]) ^ MASK(from);
+        switch (PROMO_PC(m)) {
+        case KNIGHT: return (knight_attacks(to) & MASK(ksq)) != 0;
+        case BISHOP: return (bishop_attacks(to, occupied) & MASK(ksq)) != 0;
+        case ROOK:   return (rook_attacks(to, occupied) & MASK(ksq)) != 0;
+        default:     return (queen_attacks(to, occupied) & MASK(ksq)) != 0;
+        }
+    case FLG_EP:
+        // the captured pawn can uncover a check too
+        capsq = side == WHITE ? to - 8 : to + 8;
+        occupied = ((pos->side[WHITE] | pos->side[BLACK]) ^ MASK(from) ^ MASK(capsq)) | MASK(to);
+        return (rook_attacks(ksq, occupied) & (PIECES(*pos, side, ROOK) | queens)) ||
+            (bishop_attacks(ksq, occupied) & (PIECES(*pos, side, BISHOP) | queens));
+    case FLG_CASTLE:
+        rfrom = to > from ? to + 1 : to - 2;
+        rto = to > from ? to - 1 : to + 1;
+        occupied = ((pos->side[WHITE] | pos->side[BLACK]) ^ MASK(from) ^ MASK(rfrom)) | MASK(to) | MASK(rto);
+        return (rook_attacks(rto, occupied) & MASK(ksq)) != 0;
+    default:
+        return 0;
+    }
+}
+
+/*extern*/ int is_pseudo_legal(const struct position *const restrict pos, move m) {
+    const uint8_t side = pos->wtm;
+    const uint8_t contra = FLIP(side);
+    const int from = FROM(m);
+    const int to = TO(m);
+    const int pc = pos->sqtopc[from];
+    const uint64_t occupied = pos->side[WHITE] | pos->side[BLACK];
+    const uint64_t king = PIECES(*pos, side, KING);
+    const int ksq = lsb(king);
+    const uint64_t last_rank = side == WHITE ? 0xff00000000000000ull : 0xffull;
+    uint64_t checkers;
+    uint64_t targets;
+    uint64_t reach;
+    int capsq;
+    move castles[2];
+    move *end;
+
+    if (pc == EMPTY || PIECECOLOR(pc) != side || (pos->side[side] & MASK(to)) || (PIECES(*pos, contra, KING) & MASK(to))) {
+        return 0;
+    }
+    if (FLAGS(m) != FLG_PROMO && PROMO_PC(m) != 0) {
+        return 0;
+    }
+
+    switch (FLAGS(m)) {
+    case FLG_CASTLE:
+        // generate_castling() checks everything, castling through check included
+        end = generate_castling(pos, side, from, &castles[0]);
+        return (end > &castles[0] && castles[0] == m) || (end > &castles[1] && castles[1] == m);
+    case FLG_EP:
+        if (pc != PIECE(side, PAWN) || to != pos->enpassant || !(pawn_attacks(contra, to) & MASK(from))) {
+            return 0;
+        }
+        break;
+    default:
+        if (pc % NPIECES == PAWN) {
+            if ((FLAGS(m) == FLG_PROMO) != ((MASK(to) & last_rank) != 0)) {
+                return 0;
+            }
+            reach = pawn_attacks(side, from) & pos->side[contra];
+            if (side == WHITE) {
+                reach |= MASK(from + 8) & ~occupied;
+                reach |= (reach & THIRD_RANK & ~pos->side[contra]) << 8 & ~occupied;
+            } else {
+                reach |= MASK(from - 8) & ~occupied;
+                reach |= (reach & SIXTH_RANK & ~pos->side[contra]) >> 8 & ~occupied;
+            }
+        } else if (FLAGS(m) == FLG_PROMO) {
+            return 0;
+        } else {
+            switch (pc % NPIECES) {
+            case KNIGHT: reach = knight_attacks(from); break;
+            case BISHOP: reach = bishop_attacks(from, occupied); break;
+            case ROOK:   reach = rook_attacks(from, occupied); break;
+            case QUEEN:  reach = queen_attacks(from, occupied); break;
+            default:     reach = king_attacks(from); break;
+            }
+        }
+        if (!(reach & MASK(to))) {
+            return 0;
+        }
+        break;
+    }
+
+    // king moves are checked in full, sliders' lines through the king included
+    if (pc == PIECE(side, KING)) {
+        return !attacked_with(pos, side, to, occupied ^ king);
+    }
+    // other moves out of check have to capture the checker or block
+    checkers = generate_checkers(pos, side);
+    if (checkers) {
+        if (more_than_one_piece(checkers)) {
+            return 0;
+        }
+        targets = checkers | between_sqs(lsb(checkers), ksq);
+        if (FLAGS(m) == FLG_EP) {
+            capsq = side == WHITE ? to - 8 : to + 8;
+            return ((MASK(to) | MASK(capsq)) & targets) != 0;
+        }
+        return (MASK(to) & targets) != 0;
+    }
+    return 1;
+}
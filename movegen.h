@@ -12,6 +12,10 @@
 #define more_than_one_piece(bb) power_of_two(bb)
 
 extern int is_legal(const struct position *const restrict pos, uint64_t pinned, move m);
+// Whether `m' could have come from generate_legal_moves() apart from pins,
+// i.e. is_legal() is enough to finish the job.  For moves that weren't
+// generated here: hash and killer moves.
+extern int is_pseudo_legal(const struct position *const restrict pos, move m);
 extern uint64_t generate_checkers(const struct position *const restrict pos, uint8_t side);
 extern uint64_t generate_attacked(const struct position *const restrict pos, const uint8_t side);
 extern int attacks(const struct position *const restrict pos, uint8_t side, int square);
@@ -19,5 +23,20 @@ extern uint64_t generate_pinned(const struct position *const restrict pos, uint8
 extern move *generate_evasions(const struct position *const restrict pos, uint64_t checkers, move *restrict moves);
 extern move *generate_non_evasions(const struct position *const restrict pos, move *restrict moves);
 extern int generate_legal_moves(const struct position *const restrict pos, move *restrict moves);
+// stops at the first legal move found, for mate and stalemate detection
+extern int has_legal_move(const struct position *const restrict pos);
+
+// What gives_check() needs to know about the side to move's opponent:
+// `squares[type]' - squares a piece of `type' would give check from
+// `discovered'    - our pieces that block a slider's line to their king
+struct check_info {
+    uint64_t squares[NPIECES];
+    uint64_t discovered;
+    int ksq;
+};
+
+extern void check_info_init(const struct position *const restrict pos, struct check_info *restrict ci);
+// whether legal move `m' checks the opponent, without making it
+extern int gives_check(const struct position *const restrict pos, const struct check_info *restrict ci, move m);
 
 #endif // MOVEGEN__H_
@@ -0,0 +1,383 @@
+#define _GNU_SOURCE
+#include "nnue.h"
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "position.h"
+#include "movegen.h"
+
+#define ALIGN64(x) (((x) + 63) & ~(size_t)63)
+
+// points into the mmap()'d weights file
+static struct {
+    void *map;
+    size_t size;
+    const int16_t *ft_bias;
+    const int16_t *ft_weights;
+    const int32_t *l1_bias;
+    const int8_t  *l1_weights;
+    const int32_t *l2_bias;
+    const int8_t  *l2_weights;
+    const int32_t *out_bias;
+    const int8_t  *out_weights;
+} net;
+
+int nnue_enabled = 0;
+_Thread_local struct nnue_stats nnue_stats;
+
+static _Thread_local struct {
+    struct nnue_accumulator entries[NNUE_STACK_SIZE];
+    uint32_t top;
+} stack;
+
+#define ENTRY(i) (&stack.entries[(i) & (NNUE_STACK_SIZE - 1)])
+
+/*extern*/ int nnue_load(const char *path) {
+    int fd;
+    struct stat st;
+    size_t off;
+    const struct nnue_header *hdr;
+    unsigned char *base;
+
+    nnue_unload();
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+	return 1;
+    }
+    if (fstat(fd, &st) != 0) {
+	close(fd);
+	return 2;
+    }
+    net.size = st.st_size;
+    net.map = mmap(0, net.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (net.map == MAP_FAILED) {
+	net.map = 0;
+	return 3;
+    }
+    madvise(net.map, net.size, MADV_WILLNEED);
+
+    base = net.map;
+    hdr = net.map;
+    off = ALIGN64(sizeof(*hdr));
+    #define SECTION(field, type, count) do {		\
+	net.field = (const type *)(base + off);		\
+	off = ALIGN64(off + sizeof(type) * (count));	\
+    } while (0)
+    SECTION(ft_bias, int16_t, NNUE_L1);
+    SECTION(ft_weights, int16_t, (size_t)NNUE_FEATURES * NNUE_L1);
+    SECTION(l1_bias, int32_t, NNUE_L2);
+    SECTION(l1_weights, int8_t, NNUE_L2 * 2 * NNUE_L1);
+    SECTION(l2_bias, int32_t, NNUE_L3);
+    SECTION(l2_weights, int8_t, NNUE_L3 * NNUE_L2);
+    SECTION(out_bias, int32_t, 1);
+    SECTION(out_weights, int8_t, NNUE_L3);
+    #undef SECTION
+
+    if (net.size < sizeof(*hdr) ||
+	memcmp(hdr->magic, NNUE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	hdr->features != NNUE_FEATURES || hdr->l1 != NNUE_L1 ||
+	hdr->l2 != NNUE_L2 || hdr->l3 != NNUE_L3 || net.size < off) {
+	nnue_unload();
+	return 4;
+    }
+    nnue_enabled = 1;
+    return 0;
+}
+
+/*extern*/ void nnue_unload(void) {
+    if (net.map) {
+	munmap(net.map, net.size);
+    }
+    memset(&net, 0, sizeof(net));
+    nnue_enabled = 0;
+}
+
+static force_inline int orient(int perspective, int sq) {
+    return perspective == WHITE ? sq : sq ^ 56;
+}
+
+static force_inline int feature(int perspective, int ksq, int pc, int sq) {
+    const int rel = PIECECOLOR(pc) == perspective ? 0 : 5;
+    return ksq * 640 + (rel + pc % NPIECES) * 64 + orient(perspective, sq);
+}
+
+static force_inline void acc_add(int16_t *restrict acc, int f) {
+    const int16_t *restrict w = &net.ft_weights[(size_t)f * NNUE_L1];
+    int i;
+#ifdef __AVX2__
+    for (i = 0; i < NNUE_L1; i += 16) {
+	__m256i a = _mm256_load_si256((const __m256i *)&acc[i]);
+	__m256i b = _mm256_load_si256((const __m256i *)&w[i]);
+	_mm256_store_si256((__m256i *)&acc[i], _mm256_add_epi16(a, b));
+    }
+#else
+    for (i = 0; i < NNUE_L1; ++i) {
+	acc[i] += w[i];
+    }
+#endif
+}
+
+static force_inline void acc_sub(int16_t *restrict acc, int f) {
+    const int16_t *restrict w = &net.ft_weights[(size_t)f * NNUE_L1];
+    int i;
+#ifdef __AVX2__
+    for (i = 0; i < NNUE_L1; i += 16) {
+	__m256i a = _mm256_load_si256((const __m256i *)&acc[i]);
+	__m256i b = _mm256_load_si256((const __m256i *)&w[i]);
+	_mm256_store_si256((__m256i *)&acc[i], _mm256_sub_epi16(a, b));
+    }
+#else
+    for (i = 0; i < NNUE_L1; ++i) {
+	acc[i] -= w[i];
+    }
+#endif
+}
+
+static void refresh(struct nnue_accumulator *restrict a, const struct position *restrict pos, int perspective) {
+    const int ksq = orient(perspective, lsb(PIECES(*pos, perspective, KING)));
+    uint64_t pcs = (pos->side[WHITE] | pos->side[BLACK]) &
+	~(PIECES(*pos, WHITE, KING) | PIECES(*pos, BLACK, KING));
+    int sq;
+    memcpy(a->acc[perspective], net.ft_bias, sizeof(a->acc[perspective]));
+    while (pcs) {
+	sq = lsb(pcs);
+	acc_add(a->acc[perspective], feature(perspective, ksq, pos->sqtopc[sq], sq));
+	clear_lsb(pcs);
+    }
+    a->computed[perspective] = 1;
+    ++nnue_stats.refreshes;
+}
+
+// bring `a' up to date from the entry before it, which must be computed
+static void update(struct nnue_accumulator *restrict a, const struct nnue_accumulator *restrict prev,
+		   int perspective, int ksq) {
+    int i;
+    const struct nnue_dirty *d;
+    memcpy(a->acc[perspective], prev->acc[perspective], sizeof(a->acc[perspective]));
+    for (i = 0; i < a->ndirty; ++i) {
+	d = &a->dirty[i];
+	if (d->from != EP_NONE) {
+	    acc_sub(a->acc[perspective], feature(perspective, ksq, d->pc, d->from));
+	}
+	if (d->to != EP_NONE) {
+	    acc_add(a->acc[perspective], feature(perspective, ksq, d->pc, d->to));
+	}
+    }
+    a->computed[perspective] = 1;
+    ++nnue_stats.updates;
+}
+
+// Walk back to the nearest computed ancestor and replay the moves since,
+// falling back to a refresh if a king move or the start of the stack is in
+// the way.
+static void accumulate(const struct position *restrict pos, int perspective) {
+    const int ksq = orient(perspective, lsb(PIECES(*pos, perspective, KING)));
+    struct nnue_accumulator *a = ENTRY(stack.top);
+    uint32_t i = stack.top;
+    if (a->computed[perspective]) {
+	return;
+    }
+    while (!ENTRY(i)->computed[perspective]) {
+	if (ENTRY(i)->refresh[perspective] || stack.top - i == NNUE_STACK_SIZE - 1) {
+	    refresh(a, pos, perspective);
+	    return;
+	}
+	--i;
+    }
+    for (++i; i != stack.top + 1; ++i) {
+	update(ENTRY(i), ENTRY(i - 1), perspective, ksq);
+    }
+}
+
+// clip the accumulators into the input of the first hidden layer, side to
+// move first
+static void transform(const struct nnue_accumulator *restrict a, int stm, uint8_t *restrict out) {
+    int p;
+    int i;
+    const int16_t *acc;
+    for (p = 0; p < 2; ++p) {
+	acc = a->acc[p == 0 ? stm : FLIP(stm)];
+#ifdef __AVX2__
+	const __m256i zero = _mm256_setzero_si256();
+	for (i = 0; i < NNUE_L1; i += 32) {
+	    __m256i lo = _mm256_load_si256((const __m256i *)&acc[i]);
+	    __m256i hi = _mm256_load_si256((const __m256i *)&acc[i + 16]);
+	    // packs works within 128 bit lanes, the permute puts them back in order
+	    __m256i v = _mm256_max_epi8(_mm256_packs_epi16(lo, hi), zero);
+	    _mm256_store_si256((__m256i *)&out[p * NNUE_L1 + i], _mm256_permute4x64_epi64(v, 0xd8));
+	}
+#else
+	for (i = 0; i < NNUE_L1; ++i) {
+	    out[p * NNUE_L1 + i] = acc[i] < 0 ? 0 : acc[i] > 127 ? 127 : acc[i];
+	}
+#endif
+    }
+}
+
+// out[j] = bias[j] + sum_i in[i] * w[j][i], `n' a multiple of 32
+static void dense(const uint8_t *restrict in, const int8_t *restrict w, const int32_t *restrict bias,
+		  int32_t *restrict out, int n, int m) {
+    int i;
+    int j;
+#ifdef __AVX2__
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (j = 0; j < m; ++j) {
+	__m256i sum = _mm256_setzero_si256();
+	for (i = 0; i < n; i += 32) {
+	    __m256i x = _mm256_load_si256((const __m256i *)&in[i]);
+	    __m256i y = _mm256_load_si256((const __m256i *)&w[j * n + i]);
+	    // u8 x i8 pairs summed to i16 can't saturate with inputs <= 127
+	    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, y), ones));
+	}
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+	out[j] = bias[j] + _mm_cvtsi128_si32(s);
+    }
+#else
+    for (j = 0; j < m; ++j) {
+	int32_t sum = bias[j];
+	for (i = 0; i < n; ++i) {
+	    sum += in[i] * w[j * n + i];
+	}
+	out[j] = sum;
+    }
+#endif
+}
+
+static void clipped_relu(const int32_t *restrict in, uint8_t *restrict out, int n) {
+    int i;
+    int32_t v;
+    for (i = 0; i < n; ++i) {
+	v = in[i] >> NNUE_SHIFT;
+	out[i] = v < 0 ? 0 : v > 127 ? 127 : v;
+    }
+}
+
+/*extern*/ int nnue_evaluate(const struct position *restrict pos) {
+    _Alignas(64) uint8_t input[2 * NNUE_L1];
+    _Alignas(64) uint8_t hidden1[NNUE_L2];
+    _Alignas(64) uint8_t hidden2[NNUE_L3];
+    _Alignas(64) int32_t sums[NNUE_L2 > NNUE_L3 ? NNUE_L2 : NNUE_L3];
+    struct nnue_accumulator *a = ENTRY(stack.top);
+    int32_t out;
+    int i;
+
+    ++nnue_stats.evals;
+    if (a->key != pos->hash) {
+	// not the position the stack was tracking (e.g. built without -DNNUE)
+	a->key = pos->hash;
+	a->computed[WHITE] = a->computed[BLACK] = 0;
+	a->refresh[WHITE] = a->refresh[BLACK] = 1;
+    }
+    accumulate(pos, WHITE);
+    accumulate(pos, BLACK);
+
+    transform(a, pos->wtm, input);
+    dense(input, net.l1_weights, net.l1_bias, sums, 2 * NNUE_L1, NNUE_L2);
+    clipped_relu(sums, hidden1, NNUE_L2);
+    dense(hidden1, net.l2_weights, net.l2_bias, sums, NNUE_L2, NNUE_L3);
+    clipped_relu(sums, hidden2, NNUE_L3);
+    out = *net.out_bias;
+    for (i = 0; i < NNUE_L3; ++i) {
+	out += hidden2[i] * net.out_weights[i];
+    }
+    out /= NNUE_OUTPUT_SCALE;
+    return pos->wtm == WHITE ? out : -out;
+}
+
+/*extern*/ void nnue_reset(const struct position *restrict pos) {
+    struct nnue_accumulator *a;
+    stack.top = 0;
+    a = ENTRY(0);
+    a->key = pos->hash;
+    a->computed[WHITE] = a->computed[BLACK] = 0;
+    a->refresh[WHITE] = a->refresh[BLACK] = 1;
+    a->ndirty = 0;
+    // search only evaluates leaves, so without a computed root every
+    // evaluation would have nothing to update from
+    if (nnue_enabled) {
+	refresh(a, pos, WHITE);
+	refresh(a, pos, BLACK);
+    }
+}
+
+#define DIRTY(a, p, f, t) do {				\
+	(a)->dirty[(a)->ndirty].pc = (p);		\
+	(a)->dirty[(a)->ndirty].from = (f);		\
+	(a)->dirty[(a)->ndirty].to = (t);		\
+	++(a)->ndirty;					\
+    } while (0)
+
+// Called by make_move() before the board changes, `key' is the hash of the
+// position after `m'.
+/*extern*/ void nnue_push(const struct position *restrict pos, move m, uint64_t key) {
+    const struct nnue_accumulator *prev = ENTRY(stack.top);
+    struct nnue_accumulator *a = ENTRY(++stack.top);
+    const int side = pos->wtm;
+    const int fromsq = FROM(m);
+    const int tosq = TO(m);
+    const int pc = pos->sqtopc[fromsq];
+    const int topc = pos->sqtopc[tosq];
+    // a position made on a scratch copy without a matching pop leaves the
+    // stack out of step with the game, don't trust anything before it
+    const int sync = prev->key == pos->hash;
+
+    a->key = key;
+    a->computed[WHITE] = a->computed[BLACK] = 0;
+    a->refresh[WHITE] = a->refresh[BLACK] = !sync;
+    a->ndirty = 0;
+    switch (FLAGS(m)) {
+    case FLG_NONE:
+	if (pc == PIECE(side, KING)) {
+	    a->refresh[side] = 1;
+	} else {
+	    DIRTY(a, pc, fromsq, tosq);
+	}
+	if (topc != EMPTY) {
+	    DIRTY(a, topc, tosq, EP_NONE);
+	}
+	break;
+    case FLG_EP:
+	DIRTY(a, pc, fromsq, tosq);
+	DIRTY(a, PIECE(FLIP(side), PAWN), side == WHITE ? tosq - 8 : tosq + 8, EP_NONE);
+	break;
+    case FLG_PROMO:
+	DIRTY(a, pc, fromsq, EP_NONE);
+	DIRTY(a, PIECE(side, PROMO_PC(m)), EP_NONE, tosq);
+	if (topc != EMPTY) {
+	    DIRTY(a, topc, tosq, EP_NONE);
+	}
+	break;
+    case FLG_CASTLE:
+	a->refresh[side] = 1;
+	switch (tosq) {
+	case G1: DIRTY(a, PIECE(WHITE, ROOK), H1, F1); break;
+	case C1: DIRTY(a, PIECE(WHITE, ROOK), A1, D1); break;
+	case G8: DIRTY(a, PIECE(BLACK, ROOK), H8, F8); break;
+	case C8: DIRTY(a, PIECE(BLACK, ROOK), A8, D8); break;
+	default: unreachable();
+	}
+	break;
+    default:
+	unreachable();
+    }
+}
+
+/*extern*/ void nnue_pop(void) {
+    --stack.top;
+}
+
+/*extern*/ void nnue_stats_print(FILE *os) {
+    const uint64_t total = nnue_stats.updates + nnue_stats.refreshes;
+    fprintf(os, "nnue: evals = %" PRIu64 ", incremental updates = %" PRIu64 " (%.1f%%), refreshes = %" PRIu64 "\n",
+	    nnue_stats.evals, nnue_stats.updates, total ? 100.0 * nnue_stats.updates / total : 0.0,
+	    nnue_stats.refreshes);
+}
@@ -0,0 +1,104 @@
+#ifndef NNUE__H_
+#define NNUE__H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "move.h"
+
+// Efficiently updatable neural network evaluation.
+//
+// Features are HalfKP: for each side ("perspective") one input per
+// (own king square, non-king piece, piece square), with squares mirrored
+// vertically for black so both halves share weights.  The first layer is
+// kept as a per-ply accumulator that make_move() updates with only the
+// pieces that moved (when built with -DNNUE), the remaining small layers run
+// on quantised int8 weights:
+//
+//   2 x 256 (int16 accumulator, clipped to 0..127)
+//     -> 32 (int8 weights, clipped ReLU) -> 32 (int8, clipped ReLU) -> 1
+//
+// Weights file layout (little endian, every section starts on a 64 byte
+// boundary so the mmap()'d file can be used in place):
+//   struct nnue_header
+//   int16_t ft_bias[NNUE_L1]
+//   int16_t ft_weights[NNUE_FEATURES][NNUE_L1]
+//   int32_t l1_bias[NNUE_L2]
+//   int8_t  l1_weights[NNUE_L2][2 * NNUE_L1]
+//   int32_t l2_bias[NNUE_L3]
+//   int8_t  l2_weights[NNUE_L3][NNUE_L2]
+//   int32_t out_bias
+//   int8_t  out_weights[NNUE_L3]
+#define NNUE_FEATURES (64 * 10 * 64)
+#define NNUE_L1 256
+#define NNUE_L2 32
+#define NNUE_L3 32
+#define NNUE_MAGIC "CHSNNUE1"
+#define NNUE_SHIFT 6         // hidden layer outputs are scaled down by 2^NNUE_SHIFT
+#define NNUE_OUTPUT_SCALE 16 // network output units per centipawn
+#define DEFAULT_NNUE_FILE "chess.nnue"
+
+struct nnue_header {
+    _Alignas(64) char magic[8];
+    uint32_t features;
+    uint32_t l1;
+    uint32_t l2;
+    uint32_t l3;
+};
+
+// A piece that changed square: `from' or `to' is EP_NONE for a piece that
+// was removed from or added to the board.
+struct nnue_dirty {
+    uint8_t pc;
+    uint8_t from;
+    uint8_t to;
+};
+
+// One accumulator per ply.  `key' is the hash of the position the entry is
+// for, `refresh[c]' is set when perspective `c' can't be derived from the
+// previous ply (own king moved, or the stack lost track of the game).
+struct nnue_accumulator {
+    _Alignas(64) int16_t acc[2][NNUE_L1];
+    uint64_t key;
+    uint8_t computed[2];
+    uint8_t refresh[2];
+    uint8_t ndirty;
+    struct nnue_dirty dirty[3];
+};
+
+#define NNUE_STACK_SIZE 128 // ring, must be a power of 2 > MAX_PLY
+
+struct nnue_stats {
+    uint64_t evals;
+    uint64_t updates;   // accumulator perspectives brought up to date incrementally
+    uint64_t refreshes; // ... and rebuilt from scratch
+};
+
+extern _Thread_local struct nnue_stats nnue_stats;
+
+// set once a weights file is loaded, eval() uses the network when it is
+extern int nnue_enabled;
+
+extern int nnue_load(const char *path);
+extern void nnue_unload(void);
+
+// score in centipawns from white's point of view
+struct position;
+extern int nnue_evaluate(const struct position *restrict pos);
+
+// accumulator stack hooks, see NNUE_PUSH/NNUE_POP
+extern void nnue_reset(const struct position *restrict pos);
+extern void nnue_push(const struct position *restrict pos, move m, uint64_t key);
+extern void nnue_pop(void);
+extern void nnue_stats_print(FILE *os);
+
+// make_move()/undo_move() only maintain the accumulator stack when built with
+// -DNNUE, otherwise every network evaluation rebuilds it from scratch.
+#ifdef NNUE
+#define NNUE_PUSH(pos, m, key) nnue_push((pos), (m), (key))
+#define NNUE_POP() nnue_pop()
+#else
+#define NNUE_PUSH(pos, m, key) ((void)0)
+#define NNUE_POP() ((void)0)
+#endif
+
+#endif // NNUE__H_
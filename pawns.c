@@ -0,0 +1,133 @@
+#include "pawns.h"
+#include <string.h>
+#include <inttypes.h>
+#include "movegen.h"
+#include "magic_tables.h"
+#include "weights.h"
+
+static _Thread_local struct pawn_entry pawn_table[PAWN_TABLE_SIZE];
+_Thread_local struct pawn_stats pawn_stats;
+
+// `front_span'  - squares in front of a pawn on its own file
+// `passed_mask' - squares that must be free of enemy pawns for a pawn to be passed
+// `support'     - squares beside or behind a pawn that a friendly pawn could
+//                 defend it from, now or by advancing
+static uint64_t front_span[2][64];
+static uint64_t passed_mask[2][64];
+static uint64_t support[2][64];
+static uint64_t adjacent_files[8];
+
+__attribute__((constructor)) static void pawns_init(void) {
+    int sq;
+    int file;
+    int rank;
+    int r;
+    uint64_t beside;
+    for (file = FILE_A; file <= FILE_H; ++file) {
+	adjacent_files[file] = (file > FILE_A ? A_FILE << (file - 1) : 0) |
+	    (file < FILE_H ? A_FILE << (file + 1) : 0);
+    }
+    for (sq = A1; sq <= H8; ++sq) {
+	file = sq & 7;
+	rank = sq >> 3;
+	front_span[WHITE][sq] = front_span[BLACK][sq] = 0;
+	support[WHITE][sq] = support[BLACK][sq] = 0;
+	for (r = rank + 1; r <= RANK_8; ++r) {
+	    front_span[WHITE][sq] |= MASK(SQUARE(file, r));
+	}
+	for (r = rank - 1; r >= RANK_1; --r) {
+	    front_span[BLACK][sq] |= MASK(SQUARE(file, r));
+	}
+	beside = adjacent_files[file];
+	for (r = RANK_1; r <= rank; ++r) {
+	    support[WHITE][sq] |= beside & (0xffull << (8 * r));
+	}
+	for (r = RANK_8; r >= rank; --r) {
+	    support[BLACK][sq] |= beside & (0xffull << (8 * r));
+	}
+	passed_mask[WHITE][sq] = front_span[WHITE][sq] |
+	    ((front_span[WHITE][sq] & ~A_FILE) >> 1) | ((front_span[WHITE][sq] & ~H_FILE) << 1);
+	passed_mask[BLACK][sq] = front_span[BLACK][sq] |
+	    ((front_span[BLACK][sq] & ~A_FILE) >> 1) | ((front_span[BLACK][sq] & ~H_FILE) << 1);
+    }
+}
+
+// `trace', if given, counts how often each weight was applied (for the tuner)
+static score_t evaluate_pawns(struct pawn_entry *restrict e, const struct position *restrict pos, uint8_t side,
+			      struct pawn_trace *restrict trace) {
+    const uint8_t contra = FLIP(side);
+    const uint64_t ours = PIECES(*pos, side, PAWN);
+    const uint64_t theirs = PIECES(*pos, contra, PAWN);
+    uint64_t pcs = ours;
+    score_t score = 0;
+    int sq;
+    int stop;
+    int rank;
+
+    e->passed[side] = 0;
+    e->attack_spans[side] = 0;
+    e->attacks[side] = side == WHITE ?
+	((ours & ~A_FILE) << 7) | ((ours & ~H_FILE) << 9) :
+	((ours & ~A_FILE) >> 9) | ((ours & ~H_FILE) >> 7);
+
+    while (pcs) {
+	sq = lsb(pcs);
+	rank = side == WHITE ? sq >> 3 : 7 - (sq >> 3);
+	stop = side == WHITE ? sq + 8 : sq - 8;
+	e->attack_spans[side] |= passed_mask[side][sq] & ~front_span[side][sq];
+
+	if (front_span[side][sq] & ours) {
+	    score += S(doubled_pawn_mg, doubled_pawn_eg);
+	    if (trace) {
+		++trace->doubled[side];
+	    }
+	} else if ((passed_mask[side][sq] & theirs) == 0) {
+	    e->passed[side] |= MASK(sq);
+	    score += S(passed_pawn_mg[rank], passed_pawn_eg[rank]);
+	    if (trace) {
+		++trace->passed[side][rank];
+	    }
+	}
+
+	if ((adjacent_files[sq & 7] & ours) == 0) {
+	    score += S(isolated_pawn_mg, isolated_pawn_eg);
+	    if (trace) {
+		++trace->isolated[side];
+	    }
+	} else if ((support[side][sq] & ours) == 0 && (pawn_attacks(side, stop) & theirs) != 0) {
+	    score += S(backward_pawn_mg, backward_pawn_eg);
+	    if (trace) {
+		++trace->backward[side];
+	    }
+	}
+	clear_lsb(pcs);
+    }
+
+    return score;
+}
+
+/*extern*/ const struct pawn_entry *pawn_probe(const struct position *restrict pos) {
+    struct pawn_entry *e = &pawn_table[pos->pawnhash & (PAWN_TABLE_SIZE - 1)];
+    ++pawn_stats.probes;
+    // an untouched entry is all zeros, which is exactly the entry for the
+    // pawnless key 0, so there is no need to mark entries as valid
+    if (e->key == pos->pawnhash) {
+	++pawn_stats.hits;
+	return e;
+    }
+    e->key = pos->pawnhash;
+    e->score = evaluate_pawns(e, pos, WHITE, 0) - evaluate_pawns(e, pos, BLACK, 0);
+    return e;
+}
+
+/*extern*/ score_t pawn_trace(const struct position *restrict pos, struct pawn_trace *restrict trace) {
+    struct pawn_entry e;
+    memset(trace, 0, sizeof(*trace));
+    return evaluate_pawns(&e, pos, WHITE, trace) - evaluate_pawns(&e, pos, BLACK, trace);
+}
+
+/*extern*/ void pawn_stats_print(FILE *os) {
+    fprintf(os, "pawn table: probes = %" PRIu64 ", hits = %" PRIu64 " (%.1f%%)\n",
+	    pawn_stats.probes, pawn_stats.hits,
+	    pawn_stats.probes ? 100.0 * pawn_stats.hits / pawn_stats.probes : 0.0);
+}
@@ -0,0 +1,46 @@
+#ifndef PAWNS__H_
+#define PAWNS__H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "position.h"
+
+// Pawn structure evaluation, cached by `pos->pawnhash'.  Pawns only move a
+// few times per line of play, so nearly every lookup should hit.
+//
+// `score'        - pawn structure terms from white's point of view
+// `passed'       - passed pawns
+// `attacks'      - squares attacked by pawns
+// `attack_spans' - squares that pawns attack now or could after advancing
+struct pawn_entry {
+    uint64_t key;
+    uint64_t passed[2];
+    uint64_t attacks[2];
+    uint64_t attack_spans[2];
+    score_t  score;
+};
+
+#define PAWN_TABLE_SIZE 8192 // entries, per thread
+
+struct pawn_stats {
+    uint64_t probes;
+    uint64_t hits;
+};
+
+extern _Thread_local struct pawn_stats pawn_stats;
+
+// how many times each pawn structure weight applies to each side
+struct pawn_trace {
+    uint8_t passed[2][8];
+    uint8_t doubled[2];
+    uint8_t isolated[2];
+    uint8_t backward[2];
+};
+
+extern const struct pawn_entry *pawn_probe(const struct position *restrict pos);
+extern void pawn_stats_print(FILE *os);
+
+// uncached evaluation that also fills in `trace'
+extern score_t pawn_trace(const struct position *restrict pos, struct pawn_trace *restrict trace);
+
+#endif // PAWNS__H_
@@ -3,9 +3,11 @@
 #include <string.h>
 #include <inttypes.h>
 #include "movegen.h"
+#include "stack.h"
 
 static uint64_t perft(int depth,
 		      struct position *restrict pos,
+		      struct frame *restrict f,
 		      uint64_t *captures,
 		      uint64_t *eps,
 		      uint64_t *castles,
@@ -15,9 +17,8 @@ static uint64_t perft(int depth,
     int i;
     int nmoves;
     uint64_t nodes = 0;    
-    move moves[MAX_MOVES];
+    move *restrict moves = &f->moves[0];
     struct position tmp;
-    struct savepos sp;
     uint32_t flags;
     
     if (depth == 0) {
@@ -37,12 +38,13 @@ static uint64_t perft(int depth,
     assert(validate_position(pos) == 0);    
     memcpy(&tmp, pos, sizeof(tmp));
     nmoves = generate_legal_moves(pos, &moves[0]);
+    assert(has_legal_move(pos) == (nmoves != 0));
 
     if (depth > 1) {
 	for (i = 0; i < nmoves; ++i) {
-	    make_move(pos, &sp, moves[i]);
-	    nodes += perft(depth - 1, pos, captures, eps, castles, promos, checks, mates);
-	    undo_move(pos, &sp, moves[i]);
+	    MAKE_MOVE(pos, &f->sp, moves[i]);
+	    nodes += perft(depth - 1, NEXT_POS(pos), f + 1, captures, eps, castles, promos, checks, mates);
+	    UNDO_MOVE(pos, &f->sp, moves[i]);
 	    assert(memcmp(pos, &tmp, sizeof(tmp)) == 0);
 	}
     } else {
@@ -62,9 +64,9 @@ static uint64_t perft(int depth,
 	    }
 
 #if COUNT_CHECKS_AND_MATES
-	    make_move(pos, &sp, moves[i]);
-	    perft(depth - 1, pos, captures, eps, castles, promos, checks, mates);
-	    undo_move(pos, &sp, moves[i]);
+	    MAKE_MOVE(pos, &f->sp, moves[i]);
+	    perft(depth - 1, NEXT_POS(pos), f + 1, captures, eps, castles, promos, checks, mates);
+	    UNDO_MOVE(pos, &f->sp, moves[i]);
 	    assert(memcmp(pos, &tmp, sizeof(tmp)) == 0);	    
 #endif
 	}
@@ -82,22 +84,21 @@ int perft_test(const struct position *restrict position,
 	       uint64_t *checks,
 	       uint64_t *mates) {
     *nodes = *captures = *eps = *castles = *promos = *checks = *mates = 0;
-    if (depth < 0) {
+    if (depth < 0 || depth > MAX_PLY) {
 	return 1;
     }
-    struct position pos;
-    memcpy(&pos, position, sizeof(pos));
-    *nodes = perft(depth, &pos, captures, eps, castles, promos, checks, mates);
+    struct searchstack *ss = &thread_stack;
+    struct frame *f = searchstack_reset(ss, position);
+    *nodes = perft(depth, &ss->pos[0], f, captures, eps, castles, promos, checks, mates);
  
     return 0;
 }
 
-uint64_t perft_speed(struct position *restrict pos, int depth) {
+static uint64_t perft_speed_helper(struct position *restrict pos, struct frame *restrict f, int depth) {
     int i;
     int nmoves;
     uint64_t nodes = 0;    
-    move moves[MAX_MOVES];
-    struct savepos sp;
+    move *restrict moves = &f->moves[0];
     
     if (depth == 0) {
 	return 1;
@@ -108,21 +109,27 @@ uint64_t perft_speed(struct position *restrict pos, int depth) {
 	nodes = nmoves;
     } else {
 	for (i = 0; i < nmoves; ++i) {
-	    make_move(pos, &sp, moves[i]);
-	    nodes += perft_speed(pos, depth - 1);	    
-	    undo_move(pos, &sp, moves[i]);
+	    MAKE_MOVE(pos, &f->sp, moves[i]);
+	    nodes += perft_speed_helper(NEXT_POS(pos), f + 1, depth - 1);
+	    UNDO_MOVE(pos, &f->sp, moves[i]);
 	}
     }
     
     return nodes;
 }
 
-static uint64_t perft_text_tree_helper(struct position *restrict pos, int depth) {
+uint64_t perft_speed(struct position *restrict pos, int depth) {
+    struct searchstack *ss = &thread_stack;
+    struct frame *f = searchstack_reset(ss, pos);
+    assert(depth <= MAX_PLY);
+    return perft_speed_helper(&ss->pos[0], f, depth);
+}
+
+static uint64_t perft_text_tree_helper(struct position *restrict pos, struct frame *restrict f, int depth) {
     int i;
     int nmoves;
-    move moves[MAX_MOVES];
+    move *restrict moves = &f->moves[0];
     uint64_t nodes = 0;
-    struct savepos sp;
     
     if (depth == 0) {
 	return 1;
@@ -133,9 +140,9 @@ static uint64_t perft_text_tree_helper(struct position *restrict pos, int depth)
 	nodes = nmoves;
     } else {
 	for (i = 0; i < nmoves; ++i) {
-	    make_move(pos, &sp, moves[i]);
-	    nodes += perft_text_tree_helper(pos, depth - 1);
-	    undo_move(pos, &sp, moves[i]);
+	    MAKE_MOVE(pos, &f->sp, moves[i]);
+	    nodes += perft_text_tree_helper(NEXT_POS(pos), f + 1, depth - 1);
+	    UNDO_MOVE(pos, &f->sp, moves[i]);
 	}
     }
     
@@ -145,18 +152,21 @@ static uint64_t perft_text_tree_helper(struct position *restrict pos, int depth)
 void perft_text_tree(struct position *restrict pos, int depth) {
     int i;
     int nmoves;
-    move moves[MAX_MOVES];
-    struct savepos sp;
     uint64_t total_nodes = 0;
     uint64_t nodes;
+    struct searchstack *ss = &thread_stack;
+    struct frame *f = searchstack_reset(ss, pos);
+    move *restrict moves = &f->moves[0];
     depth = depth > 0 ? depth : 1;
+    assert(depth <= MAX_PLY);
+    pos = &ss->pos[0];
 
     nmoves = generate_legal_moves(pos, &moves[0]);
     for (i = 0; i < nmoves; ++i) {
-	make_move(pos, &sp, moves[i]);
-	nodes = perft_text_tree_helper(pos, depth - 1);
+	MAKE_MOVE(pos, &f->sp, moves[i]);
+	nodes = perft_text_tree_helper(NEXT_POS(pos), f + 1, depth - 1);
 	total_nodes += nodes;
-	undo_move(pos, &sp, moves[i]);
+	UNDO_MOVE(pos, &f->sp, moves[i]);
 	move_print_short(moves[i]); printf(": %" PRIu64 "\n", nodes);
     }
 
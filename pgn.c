@@ -0,0 +1,412 @@
+#define _GNU_SOURCE
+#include "pgn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "movegen.h"
+#include "magic_tables.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+/*extern*/ int pgn_map(struct pgn_file *restrict f, const char *path) {
+    struct stat st;
+    void *map;
+    int fd;
+    memset(f, 0, sizeof(*f));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+	return 1;
+    }
+    if (fstat(fd, &st) != 0) {
+	close(fd);
+	return 1;
+    }
+    if (st.st_size == 0) {
+	close(fd);
+	return 0;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	return 1;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    f->map = map;
+    f->size = st.st_size;
+    return 0;
+}
+
+/*extern*/ void pgn_unmap(struct pgn_file *restrict f) {
+    if (f->map) {
+	munmap((void *)f->map, f->size);
+    }
+    memset(f, 0, sizeof(*f));
+}
+
+/*extern*/ const char *pgn_game_start(const char *p, const char *begin, const char *end) {
+    const char *q;
+    if (p <= begin) {
+	return begin;
+    }
+    while (p < end && (p = memchr(p, '[', end - p)) != 0) {
+	// back over the line break and an empty line before it
+	q = p;
+	if (q > begin && q[-1] == '\n') {
+	    --q;
+	    if (q > begin && q[-1] == '\r') {
+		--q;
+	    }
+	    if (q == begin || q[-1] == '\n') {
+		return p;
+	    }
+	}
+	++p;
+    }
+    return end;
+}
+
+/*extern*/ void pgn_iter_init(struct pgn_iter *restrict it, const char *begin, const char *end) {
+    memset(it, 0, sizeof(*it));
+    it->p = begin;
+    it->end = end;
+    it->result = PGN_NO_RESULT;
+}
+
+// `[Name "Value"]' on [p, eol), only Result and FEN are kept
+static void parse_tag(const char *p, const char *eol, int *result, const char **fen, size_t *fen_len) {
+    const char *value = memchr(p, '"', eol - p);
+    const char *end = memrchr(p, '"', eol - p);
+    size_t len;
+    if (!value || end <= value) {
+	return;
+    }
+    ++p;
+    while (p < value && IS_SPACE(*p)) {
+	++p;
+    }
+    ++value;
+    len = end - value;
+    if (strncmp(p, "Result", 6) == 0) {
+	if (len == 3 && strncmp(value, "1-0", 3) == 0) {
+	    *result = PGN_WHITE_WINS;
+	} else if (len == 3 && strncmp(value, "0-1", 3) == 0) {
+	    *result = PGN_BLACK_WINS;
+	} else if (len == 7 && strncmp(value, "1/2-1/2", 7) == 0) {
+	    *result = PGN_DRAW;
+	}
+    } else if (strncmp(p, "FEN", 3) == 0) {
+	*fen = value;
+	*fen_len = len;
+    }
+}
+
+// Reads the tags of the next game and sets up its position.  Returns 0 if
+// there are no more games.
+static int start_game(struct pgn_iter *restrict it) {
+    const char *p = it->p;
+    const char *end = it->end;
+    const char *eol;
+    const char *next;
+    const char *q;
+    const char *fen = 0;
+    char buf[128];
+    size_t fen_len = 0;
+    int have_tags = 0;
+    int blank = 0;
+    it->result = PGN_NO_RESULT;
+    while (p < end) {
+	eol = memchr(p, '\n', end - p);
+	next = eol ? eol + 1 : end;
+	eol = eol ? eol : end;
+	for (q = p; q < eol && IS_SPACE(*q); ++q) {
+	}
+	if (q == eol) {
+	    blank = have_tags;
+	} else if (*q == '[') {
+	    // a game without movetext ends at the blank line after its tags
+	    if (blank) {
+		++it->games;
+		it->result = PGN_NO_RESULT;
+		fen = 0;
+		blank = 0;
+	    }
+	    parse_tag(q, eol, &it->result, &fen, &fen_len);
+	    have_tags = 1;
+	} else if (*q != '%') {
+	    break;
+	}
+	p = next;
+    }
+    it->p = p;
+    if (p == end && !have_tags) {
+	return 0;
+    }
+    ++it->games;
+    it->in_game = 1;
+    it->ply = 0;
+    it->last = 0;
+    if (fen && fen_len < sizeof(buf)) {
+	memcpy(buf, fen, fen_len);
+	buf[fen_len] = 0;
+    }
+    if (position_from_fen(&it->pos, fen ? buf : START_FEN) != 0 ||
+	(fen && (fen_len >= sizeof(buf) || validate_position(&it->pos) != 0))) {
+	++it->bad_games;
+	pgn_iter_skip_game(it);
+    }
+    return 1;
+}
+
+/*extern*/ int pgn_iter_next(struct pgn_iter *restrict it, move *m) {
+    const char *san;
+    int len;
+    for (;;) {
+	if (!it->in_game) {
+	    if (!start_game(it)) {
+		return 0;
+	    }
+	    continue;
+	}
+	if (it->last) {
+	    make_move(&it->pos, &it->sp, it->last);
+	    it->last = 0;
+	    ++it->ply;
+	}
+	if (!pgn_next_san(&it->p, it->end, &san, &len)) {
+	    it->in_game = 0;
+	    continue;
+	}
+	*m = pgn_parse_san(&it->pos, san, len);
+	if (!*m) {
+	    ++it->bad_games;
+	    pgn_iter_skip_game(it);
+	    continue;
+	}
+	it->last = *m;
+	++it->moves;
+	return 1;
+    }
+}
+
+/*extern*/ void pgn_iter_skip_game(struct pgn_iter *restrict it) {
+    const char *san;
+    int len;
+    if (it->in_game) {
+	while (pgn_next_san(&it->p, it->end, &san, &len)) {
+	}
+    }
+    it->in_game = 0;
+    it->last = 0;
+}
+
+static const char *skip_past(const char *s, const char *end, char c) {
+    s = memchr(s, c, end - s);
+    return s ? s + 1 : end;
+}
+
+/*extern*/ int pgn_next_san(const char **p, const char *end, const char **san, int *len) {
+    const char *s = *p;
+    const char *t;
+    int depth;
+    while (s < end) {
+	switch (*s) {
+	case ' ': case '\n': case '\r': case '\t': case '.':
+	    ++s;
+	    break;
+	case '{':
+	    s = skip_past(s, end, '}');
+	    break;
+	case ';':
+	    s = skip_past(s, end, '\n');
+	    break;
+	case '(':
+	    // variations nest, and their comments may hold parentheses
+	    for (depth = 0; s < end; ) {
+		if (*s == '{') {
+		    s = skip_past(s, end, '}');
+		    continue;
+		}
+		if (*s == '(') {
+		    ++depth;
+		} else if (*s == ')' && --depth == 0) {
+		    ++s;
+		    break;
+		}
+		++s;
+	    }
+	    break;
+	case '$':
+	    for (++s; s < end && IS_DIGIT(*s); ++s) {
+	    }
+	    break;
+	case ')':
+	    // closes nothing
+	    ++s;
+	    break;
+	case '[':
+	    // the tags of the next game
+	    *p = s;
+	    return 0;
+	case '*':
+	    *p = s + 1;
+	    return 0;
+	default:
+	    // "exd6 e.p."
+	    if (end - s >= 4 && strncmp(s, "e.p.", 4) == 0) {
+		s += 4;
+		break;
+	    }
+	    for (t = s; t < end && !IS_SPACE(*t) && *t != '{' && *t != '(' && *t != ')' &&
+		     *t != ';' && *t != '$' && *t != '.'; ++t) {
+	    }
+	    if (IS_DIGIT(*s) && !(t - s >= 3 && strncmp(s, "0-0", 3) == 0)) {
+		// a move number, or the result
+		if (memchr(s, '-', t - s) || memchr(s, '/', t - s)) {
+		    *p = t;
+		    return 0;
+		}
+		s = t;
+		break;
+	    }
+	    // never hand back an empty token, the cursor has to move
+	    if (t == s) {
+		++s;
+		break;
+	    }
+	    *san = s;
+	    *len = t - s;
+	    *p = t;
+	    return 1;
+	}
+    }
+    *p = end;
+    return 0;
+}
+
+static int piece_type(char c) {
+    switch (c) {
+    case 'N': return KNIGHT;
+    case 'B': return BISHOP;
+    case 'R': return ROOK;
+    case 'Q': return QUEEN;
+    case 'K': return KING;
+    default: return -1;
+    }
+}
+
+/*extern*/ move pgn_parse_san(const struct position *restrict pos, const char *san, int len) {
+    const int side = pos->wtm;
+    const uint64_t occupied = pos->side[WHITE] | pos->side[BLACK];
+    uint64_t candidates;
+    uint64_t pinned = 0;
+    int have_pinned = 0;
+    int type = PAWN;
+    int capture = 0;
+    int from_file = -1;
+    int from_rank = -1;
+    int promo = -1;
+    int start = 0;
+    int from;
+    int to;
+    int i;
+    move found = 0;
+    move m;
+    while (len > 0 && (san[len - 1] == '+' || san[len - 1] == '#' || san[len - 1] == '!' || san[len - 1] == '?')) {
+	--len;
+    }
+    if (len >= 3 && (strncmp(san, "O-O", 3) == 0 || strncmp(san, "0-0", 3) == 0)) {
+	from = side == WHITE ? E1 : E8;
+	m = CASTLE(from, len >= 5 && san[3] == '-' ? from - 2 : from + 2);
+	return is_pseudo_legal(pos, m) ? m : 0;
+    }
+    if (len > 0 && piece_type(san[0]) >= 0) {
+	type = piece_type(san[0]);
+	start = 1;
+    }
+    // "e8=Q", "e8Q" or "e8q"
+    if (type == PAWN && len >= 3 && (IS_DIGIT(san[len - 2]) || san[len - 2] == '=')) {
+	promo = piece_type(san[len - 1] >= 'a' ? san[len - 1] - 'a' + 'A' : san[len - 1]);
+	if (promo < 0 || promo == KING) {
+	    return 0;
+	}
+	len -= san[len - 2] == '=' ? 2 : 1;
+    }
+    if (len - start < 2 || san[len - 2] < 'a' || san[len - 2] > 'h' ||
+	san[len - 1] < '1' || san[len - 1] > '8') {
+	return 0;
+    }
+    to = SQUARE(san[len - 2] - 'a', san[len - 1] - '1');
+    for (i = start; i < len - 2; ++i) {
+	if (san[i] >= 'a' && san[i] <= 'h') {
+	    from_file = san[i] - 'a';
+	} else if (san[i] >= '1' && san[i] <= '8') {
+	    from_rank = san[i] - '1';
+	} else if (san[i] == 'x') {
+	    capture = 1;
+	} else if (san[i] != '-') {
+	    return 0;
+	}
+    }
+
+    // the pieces that could get there, pawns by where they push from
+    switch (type) {
+    case KNIGHT: candidates = knight_attacks(to); break;
+    case BISHOP: candidates = bishop_attacks(to, occupied); break;
+    case ROOK:   candidates = rook_attacks(to, occupied); break;
+    case QUEEN:  candidates = queen_attacks(to, occupied); break;
+    case KING:   candidates = king_attacks(to); break;
+    default:
+	if (capture || from_file >= 0) {
+	    candidates = pawn_attacks(FLIP(side), to);
+	} else {
+	    from = side == WHITE ? to - 8 : to + 8;
+	    if (from < A1 || from > H8) {
+		return 0;
+	    }
+	    candidates = MASK(from);
+	    if (pos->sqtopc[from] == EMPTY && (MASK(from) & RANK3(side))) {
+		candidates = MASK(side == WHITE ? from - 8 : from + 8);
+	    }
+	}
+	break;
+    }
+    candidates &= PIECES(*pos, side, type);
+    if (from_file >= 0) {
+	candidates &= A_FILE << from_file;
+    }
+    if (from_rank >= 0) {
+	candidates &= 0xffull << (8 * from_rank);
+    }
+    while (candidates) {
+	from = lsb(candidates);
+	clear_lsb(candidates);
+	if (promo >= 0) {
+	    m = PROMOTION(from, to, promo);
+	} else if (type == PAWN && to == pos->enpassant && pos->sqtopc[to] == EMPTY) {
+	    m = EP_CAPTURE(from, to);
+	} else {
+	    m = MOVE(from, to);
+	}
+	if (!is_pseudo_legal(pos, m)) {
+	    continue;
+	}
+	if (!have_pinned) {
+	    pinned = generate_pinned(pos, side, side);
+	    have_pinned = 1;
+	}
+	if (!is_legal(pos, pinned, m)) {
+	    continue;
+	}
+	if (found) {
+	    return 0;
+	}
+	found = m;
+    }
+    return found;
+}
@@ -0,0 +1,73 @@
+#ifndef PGN__H_
+#define PGN__H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "move.h"
+#include "position.h"
+
+// Reading games from PGN files.
+//
+// Files are mmap()ed and read in place, nothing is copied or allocated per
+// game.  A `struct pgn_iter' walks a range of a file and yields every move
+// of every game along with the position it's played from, so the caller
+// sees the games as a stream of (position, move) pairs.  Only the Result
+// and FEN tags are read; move numbers, comments, NAGs and variations are
+// skipped.
+//
+// SAN is decoded without generating moves: the candidate pieces are the
+// ones of the named type that attack the destination square (pushes for
+// pawns), narrowed by the disambiguation, and then checked with
+// is_pseudo_legal() and is_legal() so pins break the remaining ties.
+enum {
+    PGN_BLACK_WINS,
+    PGN_DRAW,
+    PGN_WHITE_WINS,
+    PGN_NO_RESULT,
+};
+
+struct pgn_file {
+    const char *map;
+    size_t size;
+};
+
+// `pos' - the position before the move just returned by pgn_iter_next()
+// `ply' - of that move in its game, 0 for the first move
+// `result' - from the Result tag, PGN_NO_RESULT without one
+// `bad_games' - games left early because of a move that isn't legal, or a
+//               FEN tag that doesn't parse
+struct pgn_iter {
+    const char *p;
+    const char *end;
+    struct position pos;
+    struct savepos sp;
+    move last;
+    int in_game;
+    int ply;
+    int result;
+    uint64_t games;
+    uint64_t moves;
+    uint64_t bad_games;
+};
+
+extern int pgn_map(struct pgn_file *restrict f, const char *path);
+extern void pgn_unmap(struct pgn_file *restrict f);
+// The first game that starts at or after `p', for splitting a file between
+// threads: a tag line that follows a blank line.  `end' if there isn't one.
+extern const char *pgn_game_start(const char *p, const char *begin, const char *end);
+
+extern void pgn_iter_init(struct pgn_iter *restrict it, const char *begin, const char *end);
+// Returns 1 with the next move in `*m' and the position before it in
+// `it->pos', 0 once the range is done.
+extern int pgn_iter_next(struct pgn_iter *restrict it, move *m);
+// the next pgn_iter_next() starts on the following game
+extern void pgn_iter_skip_game(struct pgn_iter *restrict it);
+
+// Advances `*p' past the next SAN token of the movetext and returns it in
+// `*san' and `*len'.  Returns 0 at the end of the game, with `*p' after the
+// result or at the tags of the next game.
+extern int pgn_next_san(const char **p, const char *end, const char **san, int *len);
+// the legal move `san' stands for, 0 if it's not exactly one legal move
+extern move pgn_parse_san(const struct position *restrict pos, const char *san, int len);
+
+#endif // PGN__H_
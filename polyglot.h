@@ -0,0 +1,68 @@
+#ifndef POLYGLOT__H_
+#define POLYGLOT__H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "move.h"
+#include "position.h"
+
+// Polyglot opening books.
+//
+// A book is a file of 16 byte big-endian entries sorted by key:
+//   { uint64 key; uint16 move; uint16 weight; uint32 learn; }
+// The key is the Polyglot Zobrist key of the position, which uses its own
+// 781 published random numbers rather than our `zobrist_pcsq' and friends.
+//
+// polyglot_open() mmap()s the book, a probe is a binary search on the file
+// with no allocation.
+#define POLYGLOT_NKEYS 781
+#define DEFAULT_BOOK_FILE "book.bin"
+#define MAX_BOOK_MOVES 64
+
+// an entry with the fields in host byte order
+struct polyglot_entry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+extern uint64_t polyglot_key(const struct position *restrict pos);
+// Polyglot move encoding: to 0-5, from 6-11, promotion 12-14 (1 knight ..
+// 4 queen) and castling as the king taking its own rook.  polyglot_move()
+// returns 0 if `pm' isn't a legal move in `pos'.
+extern move polyglot_move(const struct position *restrict pos, uint16_t pm);
+extern uint16_t polyglot_encode(move m);
+
+// `chess build-book': replays the games in `files', split into pieces that
+// the threads take in turn, and counts every (position, move) in the first
+// `plies' plies of a game in a hash table of `hash_mb' MB.  A move's weight is the points it
+// scored for the side that played it, two for a win and one for a draw,
+// scaled down for positions where the weights would overflow.  Moves played
+// in fewer than `min_games' games, or that never scored, are left out.
+struct polyglot_build_options {
+    char **files;
+    int nfiles;
+    const char *output;
+    int threads;
+    int plies;
+    int min_games;
+    size_t hash_mb;
+};
+
+#define DEFAULT_BOOK_PLIES 20
+#define DEFAULT_BOOK_MIN_GAMES 3
+#define DEFAULT_BOOK_HASH_MB 256
+
+extern int polyglot_build(const struct polyglot_build_options *opts);
+
+// returns 0 on success, replacing any book already open
+extern int polyglot_open(const char *path);
+extern void polyglot_close(void);
+// The legal book moves for `pos' with their weights, in book order, at most
+// `max'.  Returns how many.
+extern int polyglot_probe(const struct position *restrict pos, move *moves, uint16_t *weights, int max);
+// a book move picked at random in proportion to its weight, 0 if none
+extern move polyglot_pick(const struct position *restrict pos);
+
+#endif // POLYGLOT__H_
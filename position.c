@@ -2,6 +2,22 @@
 #include <string.h>
 #include <assert.h>
 #include <inttypes.h>
+#include "zobrist.h"
+#include "tt.h"
+
+// castle rights that survive a move touching the square
+#define ALL CSL_ALL
+static const uint8_t castle_mask[64] = {
+    ALL & ~CSL_WQSIDE, ALL, ALL, ALL, ALL & ~(CSL_WQSIDE|CSL_WKSIDE), ALL, ALL, ALL & ~CSL_WKSIDE,
+    ALL, ALL, ALL, ALL, ALL, ALL, ALL, ALL,
+    ALL, ALL, ALL, ALL, ALL, ALL, ALL, ALL,
+    ALL, ALL, ALL, ALL, ALL, ALL, ALL, ALL,
+    ALL, ALL, ALL, ALL, ALL, ALL, ALL, ALL,
+    ALL, ALL, ALL, ALL, ALL, ALL, ALL, ALL,
+    ALL, ALL, ALL, ALL, ALL, ALL, ALL, ALL,
+    ALL & ~CSL_BQSIDE, ALL, ALL, ALL, ALL & ~(CSL_BQSIDE|CSL_BKSIDE), ALL, ALL, ALL & ~CSL_BKSIDE,
+};
+#undef ALL
 
 int position_from_fen(struct position *restrict pos, const char *fen) {
     int rank;
@@ -197,6 +213,10 @@ int position_from_fen(struct position *restrict pos, const char *fen) {
 	nmoves += c - '0';
     }
     pos->nmoves = nmoves;
+    pos->hash = zobrist_hash(pos);
+    pos->pawnhash = zobrist_pawn_hash(pos);
+    pos->score = psqt_score(pos);
+    pos->phase = psqt_phase(pos);
         
     return 0;
 }
@@ -342,11 +362,27 @@ int validate_position(struct position *restrict const pos) {
 	    return 18;
 	}
     }
+
+    if (pos->hash != zobrist_hash(pos)) {
+	printf("validate_position: hash is stale\n");
+	return 19;
+    }
+    if (pos->pawnhash != zobrist_pawn_hash(pos)) {
+	printf("validate_position: pawn hash is stale\n");
+	return 21;
+    }
+    if (pos->score != psqt_score(pos) || pos->phase != psqt_phase(pos)) {
+	printf("validate_position: piece-square score or phase is stale\n");
+	return 20;
+    }
     
     return 0;
 }
 
-extern void make_move(struct position *restrict pos, struct savepos *restrict sp, move m) {
+// `prefetch' - start loading the child's TT bucket, for callers that are
+//              going to probe it
+static force_inline void do_make_move(struct position *restrict pos, struct savepos *restrict sp, move m,
+				      int prefetch) {
     const uint8_t  side      = pos->wtm;
     const uint8_t  contra    = FLIP(side);
     const uint32_t tosq      = TO(m);
@@ -361,11 +397,73 @@ extern void make_move(struct position *restrict pos, struct savepos *restrict sp
     uint8_t  *restrict s2p   = pos->sqtopc;
     uint64_t *restrict rooks = &pos->brd[PIECE(side, ROOK)];
     int epsq;
+    uint64_t hash = pos->hash ^ zobrist_wtm ^ zobrist_castle[pos->castle] ^ zobrist_ep[pos->enpassant];
+    uint64_t pawnhash = pos->pawnhash;
+    score_t score = pos->score;
+    int phase = pos->phase;
+    const uint8_t castle = pos->castle & castle_mask[fromsq] & castle_mask[tosq];
+    uint8_t ep = EP_NONE;
 
     assert(tosq != fromsq);
     assert(topc != PIECE(WHITE, KING) && topc != PIECE(BLACK, KING));
+
+    // Work out the child's hash before touching the board so a prefetch of
+    // its TT bucket is on the way in while the rest of the move is made.
+    // The piece-square score and phase are updated alongside it.
+    switch (flags) {
+    case FLG_NONE:
+	hash ^= zobrist_pcsq[pc][fromsq] ^ zobrist_pcsq[pc][tosq] ^ zobrist_pcsq[topc][tosq];
+	pawnhash ^= zobrist_pawn[pc][fromsq] ^ zobrist_pawn[pc][tosq] ^ zobrist_pawn[topc][tosq];
+	score += psqt[pc][tosq] - psqt[pc][fromsq] - psqt[topc][tosq];
+	phase -= phase_inc[topc];
+	if (pc == PIECE(side, PAWN) && (from & RANK2(side)) && (to & EP_SQUARES(side))) {
+	    ep = side == WHITE ? tosq - 8 : tosq + 8;
+	}
+	break;
+    case FLG_EP:
+	hash ^= zobrist_pcsq[pc][fromsq] ^ zobrist_pcsq[pc][tosq];
+	hash ^= zobrist_pcsq[PIECE(contra, PAWN)][side == WHITE ? tosq - 8 : tosq + 8];
+	pawnhash ^= zobrist_pawn[pc][fromsq] ^ zobrist_pawn[pc][tosq];
+	pawnhash ^= zobrist_pawn[PIECE(contra, PAWN)][side == WHITE ? tosq - 8 : tosq + 8];
+	score += psqt[pc][tosq] - psqt[pc][fromsq];
+	score -= psqt[PIECE(contra, PAWN)][side == WHITE ? tosq - 8 : tosq + 8];
+	break;
+    case FLG_PROMO:
+	hash ^= zobrist_pcsq[pc][fromsq] ^ zobrist_pcsq[promopc][tosq] ^ zobrist_pcsq[topc][tosq];
+	pawnhash ^= zobrist_pawn[pc][fromsq] ^ zobrist_pawn[topc][tosq];
+	score += psqt[promopc][tosq] - psqt[pc][fromsq] - psqt[topc][tosq];
+	phase += phase_inc[promopc] - phase_inc[topc];
+	break;
+    case FLG_CASTLE:
+	hash ^= zobrist_pcsq[pc][fromsq] ^ zobrist_pcsq[pc][tosq];
+	score += psqt[pc][tosq] - psqt[pc][fromsq];
+	#define CASTLE_ROOK(rook, rfrom, rto) do {				\
+	    hash ^= zobrist_pcsq[rook][rfrom] ^ zobrist_pcsq[rook][rto];	\
+	    score += psqt[rook][rto] - psqt[rook][rfrom];			\
+	} while (0)
+	switch (tosq) {
+	case G1: CASTLE_ROOK(PIECE(WHITE, ROOK), H1, F1); break;
+	case C1: CASTLE_ROOK(PIECE(WHITE, ROOK), A1, D1); break;
+	case G8: CASTLE_ROOK(PIECE(BLACK, ROOK), H8, F8); break;
+	case C8: CASTLE_ROOK(PIECE(BLACK, ROOK), A8, D8); break;
+	default: unreachable();
+	}
+	#undef CASTLE_ROOK
+	break;
+    default:
+	unreachable();
+    }
+    hash ^= zobrist_castle[castle] ^ zobrist_ep[ep];
+    if (prefetch) {
+	tt_prefetch(hash);
+    }
+    NNUE_PUSH(pos, m, hash);
     
     // update savepos
+    sp->hash = pos->hash;
+    sp->pawnhash = pos->pawnhash;
+    sp->score = pos->score;
+    sp->phase = pos->phase;
     sp->halfmoves = pos->halfmoves;
     sp->enpassant = pos->enpassant;
     sp->castle = pos->castle;
@@ -546,11 +644,38 @@ extern void make_move(struct position *restrict pos, struct savepos *restrict sp
 	++pos->halfmoves;
     }
     ++pos->nmoves;
+    pos->hash = hash;
+    pos->pawnhash = pawnhash;
+    pos->score = score;
+    pos->phase = phase;
 
+    assert(pos->castle == castle);
+    assert(pos->enpassant == ep);
     assert(pos->enpassant == EP_NONE || pc == PIECE(side,PAWN));
     assert(validate_position(pos) == 0);
 }
 
+extern void make_move(struct position *restrict pos, struct savepos *restrict sp, move m) {
+    do_make_move(pos, sp, m, 0);
+}
+
+extern void make_move_prefetch(struct position *restrict pos, struct savepos *restrict sp, move m) {
+    do_make_move(pos, sp, m, 1);
+}
+
+void copy_make_move(struct position *restrict dst, const struct position *restrict src, move m) {
+    // the saved state is never read back, there is nothing to undo in copy-make
+    struct savepos sp;
+    memcpy(dst, src, sizeof(*dst));
+    do_make_move(dst, &sp, m, 0);
+}
+
+void copy_make_move_prefetch(struct position *restrict dst, const struct position *restrict src, move m) {
+    struct savepos sp;
+    memcpy(dst, src, sizeof(*dst));
+    do_make_move(dst, &sp, m, 1);
+}
+
 void undo_move(struct position *restrict pos, const struct savepos *restrict sp, move m) {
     const uint8_t side     = FLIP(pos->wtm);
     const uint32_t fromsq  = FROM(m);
@@ -583,6 +708,11 @@ void undo_move(struct position *restrict pos, const struct savepos *restrict sp,
     assert(cappc == EMPTY || (cappc >= PIECE(WHITE, KNIGHT) && cappc <= PIECE(BLACK, KING)));
     assert(flags != FLG_PROMO || (promopc >= PIECE(side, KNIGHT) && promopc <= PIECE(side, KING)));
 
+    NNUE_POP();
+    pos->hash = sp->hash;
+    pos->pawnhash = sp->pawnhash;
+    pos->score = sp->score;
+    pos->phase = sp->phase;
     pos->halfmoves = sp->halfmoves;
     pos->enpassant = sp->enpassant;
     pos->castle = sp->castle;
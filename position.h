@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "move.h"
+#include "psqt.h"
+#include "nnue.h"
 
 // TODO: remove king specific bit boards and replace with 2 x 8-bit ints with sq location
 // TODO: cache king location? (maybe taken care of by above, but will need to look at how
@@ -16,20 +18,40 @@
 //               16    = no enpassant
 //               0..7  = a3..h3
 //               8..15 = a6..h6
+// `hash'      - zobrist key of the position, maintained by make_move()/undo_move()
+// `pawnhash'  - zobrist key of just the pawns, for the pawn structure cache
+// `score'     - sum of `psqt' over all pieces (tapered eval before interpolation)
+// `phase'     - sum of `phase_inc' over all pieces, can exceed PHASE_MAX after promotions
+//
+// With COPY_MAKE the position is padded out to a whole number of cache lines so
+// that a per-ply stack of them keeps every slot aligned.
+#ifdef COPY_MAKE
+#define POSITION_ALIGN _Alignas(64)
+#else
+#define POSITION_ALIGN
+#endif
 struct position {
-    uint64_t brd[12];
+    POSITION_ALIGN uint64_t brd[12];
     uint64_t side[2];
+    uint64_t hash;
+    uint64_t pawnhash;
+    score_t  score;
     uint8_t  sqtopc[64];
     uint16_t nmoves;
     uint8_t  wtm;
     uint8_t  halfmoves;
     uint8_t  castle;
     uint8_t  enpassant;
+    uint8_t  phase;
 };
 #define PIECES(p, side, type) (p).brd[PIECE(side, type)]
 #define FULLSIDE(p, color) (p).side[color]
 
 struct savepos {
+    uint64_t hash;
+    uint64_t pawnhash;
+    score_t score;
+    uint8_t phase;
     uint8_t halfmoves;
     uint8_t enpassant;
     uint8_t castle;
@@ -42,5 +64,31 @@ extern void position_print(FILE *os, const struct position *restrict pos);
 extern int validate_position(struct position *restrict const pos);
 extern void make_move(struct position *restrict pos, struct savepos *restrict sp, move m);
 extern void undo_move(struct position *restrict pos, const struct savepos *restrict sp, move m);
+extern void copy_make_move(struct position *restrict dst, const struct position *restrict src, move m);
+// the same, but prefetching the child's TT bucket while the move is made
+extern void make_move_prefetch(struct position *restrict pos, struct savepos *restrict sp, move m);
+extern void copy_make_move_prefetch(struct position *restrict dst, const struct position *restrict src, move m);
+
+// Drivers (perft, search) walk a per-ply stack of positions through these macros
+// so they can be built either way:
+//   make/undo - every ply shares the same slot, `UNDO_MOVE' reverts the move
+//   COPY_MAKE - `MAKE_MOVE' writes the child into the next slot, undo is just
+//               returning to the parent's slot
+// `MAKE_MOVE_PREFETCH' is for a child whose TT entry is going to be probed.
+// The root caller must provide `MAX_PLY + 1' slots (see `POSITION_STACK').
+#ifdef COPY_MAKE
+#define NEXT_POS(pos) ((pos) + 1)
+#define MAKE_MOVE(pos, sp, m) ((void)(sp), copy_make_move(NEXT_POS(pos), (pos), (m)))
+#define MAKE_MOVE_PREFETCH(pos, sp, m) ((void)(sp), copy_make_move_prefetch(NEXT_POS(pos), (pos), (m)))
+#define UNDO_MOVE(pos, sp, m) ((void)(sp), (void)(m), NNUE_POP())
+#define POSITION_STACK_SIZE (MAX_PLY + 1)
+#else
+#define NEXT_POS(pos) (pos)
+#define MAKE_MOVE(pos, sp, m) make_move((pos), (sp), (m))
+#define MAKE_MOVE_PREFETCH(pos, sp, m) make_move_prefetch((pos), (sp), (m))
+#define UNDO_MOVE(pos, sp, m) undo_move((pos), (sp), (m))
+#define POSITION_STACK_SIZE 1
+#endif
+#define POSITION_STACK(name) struct position name[POSITION_STACK_SIZE]
 
 #endif // POSITION__H_
@@ -0,0 +1,50 @@
+#include "psqt.h"
+#include "weights.h"
+#include "position.h"
+
+score_t psqt[EMPTY + 1][64];
+const uint8_t phase_inc[EMPTY + 1] = {
+    [PIECE(WHITE, KNIGHT)] = 1, [PIECE(WHITE, BISHOP)] = 1, [PIECE(WHITE, ROOK)] = 2, [PIECE(WHITE, QUEEN)] = 4,
+    [PIECE(BLACK, KNIGHT)] = 1, [PIECE(BLACK, BISHOP)] = 1, [PIECE(BLACK, ROOK)] = 2, [PIECE(BLACK, QUEEN)] = 4,
+};
+
+/*extern*/ void psqt_init(void) {
+    int pc;
+    int sq;
+    int mg;
+    int eg;
+    for (pc = KNIGHT; pc <= KING; ++pc) {
+	for (sq = A1; sq <= H8; ++sq) {
+	    mg = piece_value_mg[pc] + psqt_mg[pc][sq];
+	    eg = piece_value_eg[pc] + psqt_eg[pc][sq];
+	    psqt[PIECE(WHITE, pc)][sq] = S(mg, eg);
+	    psqt[PIECE(BLACK, pc)][sq ^ 56] = S(-mg, -eg);
+	}
+    }
+    for (sq = A1; sq <= H8; ++sq) {
+	psqt[EMPTY][sq] = 0;
+    }
+}
+
+// run before main() so that every position_from_fen() gets a valid score
+__attribute__((constructor)) static void psqt_constructor(void) {
+    psqt_init();
+}
+
+/*extern*/ score_t psqt_score(const struct position *restrict pos) {
+    score_t score = 0;
+    int sq;
+    for (sq = A1; sq <= H8; ++sq) {
+	score += psqt[pos->sqtopc[sq]][sq];
+    }
+    return score;
+}
+
+/*extern*/ int psqt_phase(const struct position *restrict pos) {
+    int phase = 0;
+    int sq;
+    for (sq = A1; sq <= H8; ++sq) {
+	phase += phase_inc[pos->sqtopc[sq]];
+    }
+    return phase;
+}
@@ -0,0 +1,31 @@
+#ifndef PSQT__H_
+#define PSQT__H_
+
+#include <stdint.h>
+#include "move.h"
+
+// Middlegame and endgame scores packed into one int so that make_move() can
+// update both with a single add:  S(mg, eg) = eg * 2^16 + mg
+typedef int32_t score_t;
+#define S(mg, eg) ((score_t)((uint32_t)(eg) << 16) + (mg))
+#define MG(s) ((int16_t)(uint16_t)(uint32_t)(s))
+#define EG(s) ((int16_t)(uint16_t)((uint32_t)((s) + 0x8000) >> 16))
+
+// game phase: 24 with all minor and major pieces on the board, 0 with none
+#define PHASE_MAX 24
+
+// Material plus piece-square value of every piece on every square, from
+// white's point of view (black entries are negative).  The `EMPTY' row is
+// all zeros so captures don't need a branch.
+extern score_t psqt[EMPTY + 1][64];
+extern const uint8_t phase_inc[EMPTY + 1];
+
+// rebuild `psqt' from the weights in weights.c
+extern void psqt_init(void);
+
+// from scratch versions of what make_move() maintains incrementally
+struct position;
+extern score_t psqt_score(const struct position *restrict pos);
+extern int psqt_phase(const struct position *restrict pos);
+
+#endif // PSQT__H_
@@ -1,103 +1,510 @@
 #include "search.h"
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "move.h"
 #include "position.h"
 #include "movegen.h"
 #include "eval.h"
+#include "stack.h"
+#include "tt.h"
+#include "weights.h"
+#include "bitbase.h"
+#include "syzygy.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+// tablebase wins rank below mates and above any eval
+#define TB_WIN (MATE_BOUND - 1 - MAX_PLY)
+
 #define DEBUGF(...) do { fprintf(stderr, __VA_ARGS__); } while(0)
 
-int alphabeta(struct position *restrict pos, int depth, int alpha, int beta, int maximizing, move last_move) {
+_Thread_local struct search_stats search_stats;
+
+// plies of qsearch() that also try quiet checks
+#define QSEARCH_CHECKS 1
+
+static force_inline int ply_of(const struct frame *restrict f) {
+    return f - &thread_stack.frames[0];
+}
+
+// score when the side to move has no legal moves
+static force_inline int mated_score(const struct position *restrict pos, int ply) {
+    if (generate_checkers(pos, pos->wtm) == 0) {
+	return 0; // stalemate
+    }
+    return pos->wtm == WHITE ? BLACK_WIN + ply : WHITE_WIN - ply;
+}
+
+// Draw by the 50 move rule, or by repetition: a position seen once before
+// in the search (the side that repeated could have avoided it), or twice
+// before in the game.  Only positions since the last capture or pawn move
+// can repeat, and only with the same side to move.
+static int is_draw(const struct position *restrict pos, int ply) {
+    const uint64_t *keys = &thread_stack.keys[thread_stack.root + ply];
+    const int n = MIN(pos->halfmoves, thread_stack.root + ply);
+    int seen = 0;
+    int i;
+    if (pos->halfmoves >= 100) {
+	return generate_checkers(pos, pos->wtm) == 0 || has_legal_move(pos);
+    }
+    for (i = 4; i <= n; i += 2) {
+	if (keys[-i] == pos->hash && (i < ply || ++seen == 2)) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+// Mate scores are relative to the root, but a TT entry can be reached at
+// any ply, so they are stored as distance to mate from the entry's node.
+static force_inline int score_to_tt(int score, int ply) {
+    return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+
+static force_inline int score_from_tt(int score, int ply) {
+    return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;
+}
+
+// PV at `f' becomes `m' followed by the child's PV
+static void update_pv(struct frame *restrict f, move m) {
+    const struct frame *restrict child = f + 1;
+    f->pv[0] = m;
+    memcpy(&f->pv[1], &child->pv[0], child->npv * sizeof(child->pv[0]));
+    f->npv = child->npv + 1;
+}
+
+// move `m' to the front of the list if it is in it
+static void move_to_front(move *restrict moves, int nmoves, move m) {
+    int i;
+    for (i = 0; i < nmoves; ++i) {
+	if (moves[i] == m) {
+	    moves[i] = moves[0];
+	    moves[0] = m;
+	    return;
+	}
+    }
+}
+
+static force_inline int is_tactical(const struct position *restrict pos, move m) {
+    return pos->sqtopc[TO(m)] != EMPTY || FLAGS(m) == FLG_EP || FLAGS(m) == FLG_PROMO;
+}
+
+// most valuable victim, least valuable attacker
+static int16_t mvv_lva(const struct position *restrict pos, move m) {
+    const int victim = FLAGS(m) == FLG_EP ? PAWN : pos->sqtopc[TO(m)] % NPIECES;
+    const int attacker = pos->sqtopc[FROM(m)] % NPIECES;
+    int16_t score = FLAGS(m) == FLG_PROMO ? piece_value_mg[PROMO_PC(m)] : 0;
+    if (pos->sqtopc[TO(m)] != EMPTY || FLAGS(m) == FLG_EP) {
+	score += 8 * piece_value_mg[victim] - piece_value_mg[attacker] / 8;
+    }
+    return score;
+}
+
+// selection sort as we go, most lines are cut off after a move or two
+static force_inline void pick_move(move *restrict moves, int16_t *restrict scores, int i, int nmoves) {
+    int j;
+    int best = i;
+    move m;
+    int16_t sc;
+    for (j = i + 1; j < nmoves; ++j) {
+	if (scores[j] > scores[best]) {
+	    best = j;
+	}
+    }
+    m = moves[i]; moves[i] = moves[best]; moves[best] = m;
+    sc = scores[i]; scores[i] = scores[best]; scores[best] = sc;
+}
+
+// Ordering for the full width search: the TT move (searched before the
+// others are generated), captures and promotions by MVV-LVA, killers, the
+// countermove to `last_move', then the other quiet moves by history.  Quiet
+// moves that take a piece out of reach of a lesser enemy piece go a little
+// earlier, those that put it in reach of one after all the rest.
+enum {
+    ORDER_TT      = INT16_MAX,
+    ORDER_CAPTURE = 20000,
+    ORDER_KILLER1 = 19000,
+    ORDER_KILLER2 = 18000,
+    ORDER_COUNTER = 17000,
+};
+
+static void score_moves(const struct position *restrict pos, const move *restrict moves, int16_t *restrict scores,
+			int nmoves, move last_move, const struct frame *restrict f) {
+    int16_t (*history)[64] = thread_stack.quiet_history[pos->wtm];
+    const move counter = last_move ? thread_stack.countermoves[last_move & 0xfff] : 0;
+    const struct attack_info *attacks = eval_attacks(pos);
+    const uint64_t *by_type = attacks->by_type[FLIP(pos->wtm)];
+    // squares where a piece of each type can be taken by a lesser one
+    uint64_t threats[NPIECES] = {0};
+    uint64_t threatened;
+    move m;
+    int i;
+    threats[KNIGHT] = threats[BISHOP] = by_type[PAWN];
+    threats[ROOK] = threats[BISHOP] | by_type[KNIGHT] | by_type[BISHOP];
+    threats[QUEEN] = threats[ROOK] | by_type[ROOK];
+    for (i = 0; i < nmoves; ++i) {
+	m = moves[i];
+	if (is_tactical(pos, m)) {
+	    scores[i] = ORDER_CAPTURE + mvv_lva(pos, m);
+	} else if (m == f->killers[0]) {
+	    scores[i] = ORDER_KILLER1;
+	} else if (m == f->killers[1]) {
+	    scores[i] = ORDER_KILLER2;
+	} else if (m == counter) {
+	    scores[i] = ORDER_COUNTER;
+	} else {
+	    threatened = threats[pos->sqtopc[FROM(m)] % NPIECES];
+	    scores[i] = history[FROM(m)][TO(m)];
+	    if (threatened & MASK(TO(m))) {
+		// below every other quiet move, still ordered by history
+		scores[i] = (scores[i] - 3 * QUIET_HISTORY_MAX) / 2;
+	    } else if (threatened & MASK(FROM(m))) {
+		scores[i] = MIN(scores[i] + QUIET_HISTORY_MAX / 2, QUIET_HISTORY_MAX);
+	    }
+	}
+    }
+}
+
+// gravity: the closer an entry is to the limit the less a bonus moves it,
+// so entries stay in range and old results fade
+static force_inline void update_history(int16_t *entry, int bonus) {
+    *entry += bonus - *entry * abs(bonus) / QUIET_HISTORY_MAX;
+}
+
+// quiet move `moves[best]' caused a cutoff after the quiet moves before it failed
+static void update_ordering(const struct position *restrict pos, struct frame *restrict f, int best, int depth,
+			    move last_move) {
+    int16_t (*history)[64] = thread_stack.quiet_history[pos->wtm];
+    const move m = f->moves[best];
+    const int bonus = MIN(depth * depth, 400);
+    int i;
+    if (f->killers[0] != m) {
+	f->killers[1] = f->killers[0];
+	f->killers[0] = m;
+    }
+    if (last_move) {
+	thread_stack.countermoves[last_move & 0xfff] = m;
+    }
+    update_history(&history[FROM(m)][TO(m)], bonus);
+    for (i = 0; i < best; ++i) {
+	if (!is_tactical(pos, f->moves[i])) {
+	    update_history(&history[FROM(f->moves[i])][TO(f->moves[i])], -bonus);
+	}
+    }
+}
+
+// Captures and promotions, so that the static eval is never taken in the
+// middle of an exchange, plus quiet checks for the first `checks' plies.
+// The side to move may stand pat unless it is in check, in which case all
+// evasions are searched.
+/*extern*/ int qsearch(struct position *restrict pos, struct frame *restrict f, int alpha, int beta, int maximizing,
+		       int checks) {
     int best;
     int nmoves;
+    int ntactical = 0;
     int i;
     int value;
-    move moves[MAX_MOVES];
-    struct savepos sp;
-    
-    if (depth == 0) {
-	value = eval(pos);
-	DEBUGF("depth == 0, move = %s, value = %d\n", xboard_move_print(last_move), value);
-	return value;
+    move *restrict moves = &f->moves[0];
+    int16_t *restrict scores = &f->scores[0];
+    const int incheck = generate_checkers(pos, pos->wtm) != 0;
+    struct check_info ci;
+
+    ++search_stats.nodes;
+    f->npv = 0;
+    if (ply_of(f) >= MAX_PLY) {
+	return eval(pos);
+    }
+    if (incheck) {
+	best = maximizing ? NEG_INFINITI : INFINITI;
+    } else {
+	best = eval_lazy(pos, alpha, beta);
+	if (maximizing ? best >= beta : best <= alpha) {
+	    // standing pat in a stalemate would score it as the eval
+	    return has_legal_move(pos) ? best : 0;
+	}
+	if (maximizing) {
+	    alpha = MAX(alpha, best);
+	} else {
+	    beta = MIN(beta, best);
+	}
     }
+
     nmoves = generate_legal_moves(pos, &moves[0]);
-    if (nmoves == 0) { // checkmate
-	return pos->wtm ? WHITE_WIN : BLACK_WIN;
+    if (nmoves == 0) {
+	return mated_score(pos, ply_of(f));
+    }
+    if (checks > 0 && !incheck) {
+	check_info_init(pos, &ci);
+    }
+    for (i = 0; i < nmoves; ++i) {
+	if (is_tactical(pos, moves[i])) {
+	    moves[ntactical] = moves[i];
+	    scores[ntactical] = mvv_lva(pos, moves[i]);
+	    ++ntactical;
+	} else if (incheck || (checks > 0 && gives_check(pos, &ci, moves[i]))) {
+	    moves[ntactical] = moves[i];
+	    scores[ntactical] = -1;
+	    ++ntactical;
+	}
     }
 
-    if (maximizing) {
-	best = NEG_INFINITI;
-	for (i = 0; i < nmoves; ++i) {
-	    make_move(pos, &sp, moves[i]);
-	    value = alphabeta(pos, depth - 1, alpha, beta, 0, moves[i]);
-	    undo_move(pos, &sp, moves[i]);
-	    best = MAX(best, value);
+    for (i = 0; i < ntactical; ++i) {
+	pick_move(moves, scores, i, ntactical);
+	MAKE_MOVE(pos, &f->sp, moves[i]);
+	value = qsearch(NEXT_POS(pos), f + 1, alpha, beta, !maximizing, checks - 1);
+	UNDO_MOVE(pos, &f->sp, moves[i]);
+	if (maximizing) {
+	    if (value > best) {
+		best = value;
+		update_pv(f, moves[i]);
+	    }
 	    alpha = MAX(alpha, best);
+	} else {
+	    if (value < best) {
+		best = value;
+		update_pv(f, moves[i]);
+	    }
+	    beta = MIN(beta, best);
+	}
+	if (beta <= alpha) {
+	    break;
+	}
+    }
+
+    return best;
+}
+
+int alphabeta(struct position *restrict pos, struct frame *restrict f, int depth, int alpha, int beta, int maximizing, move last_move) {
+    int best;
+    int nmoves;
+    int i;
+    int value;
+    move *restrict moves = &f->moves[0];
+    move best_move = 0;
+    const int ply = ply_of(f);
+    struct tt_entry entry;
+    struct check_info ci;
+    int alpha_orig;
+    int beta_orig;
+    int bound;
+    int ext;
+    int generated;
+    int j;
+
+    thread_stack.keys[thread_stack.root + ply] = pos->hash;
+    if (is_draw(pos, ply)) {
+	f->npv = 0;
+	return 0;
+    }
+    // a bitbase draw can't be won however deep we look
+    if (ply > 0 && bitbase_count && bitbase_probe(pos) == BITBASE_DRAW) {
+	f->npv = 0;
+	return 0;
+    }
+    if (depth == 0 || ply >= MAX_PLY) {
+	return qsearch(pos, f, alpha, beta, maximizing, QSEARCH_CHECKS);
+    }
+    ++search_stats.nodes;
+    f->npv = 0;
+
+    // mate distance pruning: no score here can be better than mating on the
+    // next move or worse than being mated now, if that is outside the window
+    // a shorter mate has already been found
+    alpha = MAX(alpha, BLACK_WIN + ply);
+    beta = MIN(beta, WHITE_WIN - ply);
+    if (beta <= alpha) {
+	return alpha > BLACK_WIN + ply ? beta : alpha;
+    }
+
+    if (tt_probe(pos->hash, &entry)) {
+	best_move = entry.m;
+	if (entry.depth >= depth) {
+	    value = score_from_tt(entry.score, ply);
+	    switch (entry.bound) {
+	    case TT_EXACT: return value;
+	    case TT_LOWER: alpha = MAX(alpha, value); break;
+	    case TT_UPPER: beta = MIN(beta, value); break;
+	    default: break;
+	    }
 	    if (beta <= alpha) {
-		break; // beta cutoff
+		return value;
 	    }
 	}
+    }
+    // the window the moves are searched with, narrowed by mate distance
+    // and the TT; the bound stored at the end is relative to it
+    alpha_orig = alpha;
+    beta_orig = beta;
+
+    // the tables are exact once a capture or pawn move has reset the 50 move
+    // counter; cursed wins and blessed losses are draws under that rule
+    if (pos->halfmoves == 0 && syzygy_search && syzygy_max_pieces &&
+	popcountll(pos->side[WHITE] | pos->side[BLACK]) <= syzygy_max_pieces) {
+	int ok;
+	const int wdl = syzygy_probe_wdl(pos, &ok);
+	if (ok) {
+	    value = wdl == SYZYGY_WIN ? TB_WIN - ply : wdl == SYZYGY_LOSS ? -TB_WIN + ply : 0;
+	    value = pos->wtm == WHITE ? value : -value;
+	    tt_store(pos->hash, 0, score_to_tt(value, ply), MAX_PLY - 1, TT_EXACT);
+	    return value;
+	}
+    }
+
+    // the hash move is searched before generating anything, it often cuts
+    // off on its own; it has to be legal here, a collision could store a
+    // move from any position
+    check_info_init(pos, &ci);
+    if (best_move && is_pseudo_legal(pos, best_move) &&
+	is_legal(pos, generate_pinned(pos, pos->wtm, pos->wtm), best_move)) {
+	moves[0] = best_move;
+	f->scores[0] = ORDER_TT;
+	nmoves = 1;
+	generated = 0;
     } else {
-	best = INFINITI;
-	for (i = 0; i < nmoves; ++i) {
-	    make_move(pos, &sp, moves[i]);
-	    value = alphabeta(pos, depth - 1, alpha, beta, 1, moves[i]);
-	    undo_move(pos, &sp, moves[i]);
-	    best = MIN(best, value);
+	nmoves = generate_legal_moves(pos, &moves[0]);
+	if (nmoves == 0) {
+	    return mated_score(pos, ply);
+	}
+	score_moves(pos, &moves[0], &f->scores[0], nmoves, last_move, f);
+	generated = 1;
+    }
+    best_move = 0;
+
+    best = maximizing ? NEG_INFINITI : INFINITI;
+    for (i = 0; i < nmoves; ++i) {
+	pick_move(moves, &f->scores[0], i, nmoves);
+	ext = gives_check(pos, &ci, moves[i]);
+	// children left for qsearch() never probe the TT
+	if (depth - 1 + ext > 0) {
+	    MAKE_MOVE_PREFETCH(pos, &f->sp, moves[i]);
+	} else {
+	    MAKE_MOVE(pos, &f->sp, moves[i]);
+	}
+	value = alphabeta(NEXT_POS(pos), f + 1, depth - 1 + ext, alpha, beta, !maximizing, moves[i]);
+	UNDO_MOVE(pos, &f->sp, moves[i]);
+	if (maximizing ? value > best : value < best) {
+	    best = value;
+	    best_move = moves[i];
+	    update_pv(f, moves[i]);
+	}
+	if (maximizing) {
+	    alpha = MAX(alpha, best);
+	} else {
 	    beta = MIN(beta, best);
-	    if (beta <= alpha) {
-		break; // alpha cutoff
+	}
+	if (beta <= alpha) {
+	    break; // cutoff
+	}
+	if (!generated) {
+	    // the rest of the moves, without the hash move again
+	    nmoves = 1 + generate_legal_moves(pos, &moves[1]);
+	    for (j = 1; j < nmoves; ++j) {
+		if (moves[j] == moves[0]) {
+		    moves[j] = moves[--nmoves];
+		    break;
+		}
 	    }
+	    score_moves(pos, &moves[1], &f->scores[1], nmoves - 1, last_move, f);
+	    generated = 1;
+	}
+    }
+
+    if (beta <= alpha) {
+	++search_stats.cutoffs;
+	search_stats.first_cutoffs += i == 0;
+	if (!is_tactical(pos, moves[i])) {
+	    update_ordering(pos, f, i, depth, last_move);
 	}
     }
 
+    // scores are from white's point of view, so the bound doesn't depend on
+    // which side was maximizing
+    if (best <= alpha_orig) {
+	bound = TT_UPPER;
+    } else if (best >= beta_orig) {
+	bound = TT_LOWER;
+    } else {
+	bound = TT_EXACT;
+    }
+    tt_store(pos->hash, best_move, score_to_tt(best, ply), depth, bound);
+
     return best;
 }
 
-/*extern*/ move search(const struct position *restrict const position) {
-    struct savepos sp;
-    struct position pos;
-    move moves[MAX_MOVES];
+/*extern*/ move search(const struct position *restrict const position, const uint64_t *history, int nhistory, int depth) {
+    struct searchstack *ss = &thread_stack;
+    struct frame *f = searchstack_reset(ss, position);
+    struct position *pos = &ss->pos[0];
+    move *restrict moves = &f->moves[0];
     int nmoves;
     int i;
-    int best = position->wtm == WHITE ? NEG_INFINITI : INFINITI;
+    int d;
+    int best;
     int value;
-    move rval;
-    const int depth = 1;
+    move rval = 0;
+    const int white = position->wtm == WHITE;
 
-    memcpy(&pos, position, sizeof(pos));
-    nmoves = generate_legal_moves(&pos, &moves[0]);
+    searchstack_set_history(ss, history, nhistory);
+    memset(ss->quiet_history, 0, sizeof(ss->quiet_history));
+    memset(ss->countermoves, 0, sizeof(ss->countermoves));
+    nmoves = generate_legal_moves(pos, &moves[0]);
     DEBUGF("Generated %d legal moves\n", nmoves);
 
-    if (pos.wtm == WHITE) {
-	for (i = 0; i < nmoves; ++i) {
-	    make_move(&pos, &sp, moves[i]);
-	    DEBUGF("Checking %s\n", xboard_move_print(moves[i]));
-	    value = alphabeta(&pos, depth, NEG_INFINITI, INFINITI, 0, moves[i]);
-	    DEBUGF("value of %s -> %d\n", xboard_move_print(moves[i]), value);
-	    if (value > best) {
-		rval = moves[i];
-		best = value;
-	    }
-	    undo_move(&pos, &sp, moves[i]);
+    // in the tables the DTZ ranking picks the move without searching
+    if (syzygy_search && syzygy_max_pieces && nmoves) {
+	int dtz;
+	rval = syzygy_probe_root(pos, &dtz);
+	if (rval) {
+	    DEBUGF("syzygy: %s, dtz %d\n", xboard_move_print(rval), dtz);
+	    return rval;
 	}
-    } else {
+    }
+
+    // iterative deepening: each iteration starts with the previous best move
+    // and fills the TT with better ordering for the next one
+    for (d = 1; d <= depth; ++d) {
+	if (rval) {
+	    move_to_front(moves, nmoves, rval);
+	}
+	best = white ? NEG_INFINITI - 1 : INFINITI + 1;
 	for (i = 0; i < nmoves; ++i) {
-	    make_move(&pos, &sp, moves[i]);
-	    DEBUGF("Checking %s\n", xboard_move_print(moves[i]));	    
-	    value = alphabeta(&pos, depth, NEG_INFINITI, INFINITI, 1, moves[i]);
-	    DEBUGF("value of %s -> %d\n", xboard_move_print(moves[i]), value);
-	    if (value < best) {
+	    if (d > 1) {
+		MAKE_MOVE_PREFETCH(pos, &f->sp, moves[i]);
+	    } else {
+		MAKE_MOVE(pos, &f->sp, moves[i]);
+	    }
+	    if (white) {
+		value = alphabeta(NEXT_POS(pos), f + 1, d - 1, best, INFINITI, 0, moves[i]);
+	    } else {
+		value = alphabeta(NEXT_POS(pos), f + 1, d - 1, NEG_INFINITI, best, 1, moves[i]);
+	    }
+	    UNDO_MOVE(pos, &f->sp, moves[i]);
+	    if (white ? value > best : value < best) {
 		rval = moves[i];
 		best = value;
+		update_pv(f, moves[i]);
 	    }
-	    undo_move(&pos, &sp, moves[i]);
+	}
+
+	DEBUGF("depth %d, score %d, nodes %lu, PV:", d, best, (unsigned long)search_stats.nodes);
+	for (i = 0; i < f->npv; ++i) {
+	    DEBUGF(" %s", xboard_move_print(f->pv[i]));
+	}
+	DEBUGF("\n");
+
+	// a mate within the full width depth can't be improved on
+	if (abs(best) >= MATE_BOUND && MATE - abs(best) <= d) {
+	    break;
 	}
     }
 
     return rval;
 }
+
+/*extern*/ void search_stats_print(FILE *os) {
+    fprintf(os, "search: nodes = %" PRIu64 ", cutoffs = %" PRIu64 ", on the first move = %" PRIu64 " (%.1f%%)\n",
+	    search_stats.nodes, search_stats.cutoffs, search_stats.first_cutoffs,
+	    search_stats.cutoffs ? 100.0 * search_stats.first_cutoffs / search_stats.cutoffs : 0.0);
+}
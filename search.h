@@ -1,11 +1,32 @@
 #ifndef SEARCH__H_
 #define SEARCH__H_
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "move.h"
 #include "position.h"
 #include "movegen.h"
 
-extern move search(const struct position *restrict const position);
+#define DEFAULT_SEARCH_DEPTH 5
+
+// `cutoffs'       - nodes that failed high (or low, for the minimizing side)
+// `first_cutoffs'  - of those, how many on the first move searched
+struct search_stats {
+    uint64_t nodes;
+    uint64_t cutoffs;
+    uint64_t first_cutoffs;
+};
+
+extern _Thread_local struct search_stats search_stats;
+
+extern void search_stats_print(FILE *os);
+
+struct frame;
+extern int qsearch(struct position *restrict pos, struct frame *restrict f, int alpha, int beta, int maximizing,
+		   int checks);
+// `history' is the hashes of the `nhistory' game positions before
+// `position', oldest first, so the search can see repetitions
+extern move search(const struct position *restrict const position, const uint64_t *history, int nhistory, int depth);
 
 #endif // SEARC__H_
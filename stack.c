@@ -0,0 +1,31 @@
+#include "stack.h"
+#include <string.h>
+
+_Thread_local struct searchstack thread_stack;
+
+/*extern*/ struct frame *searchstack_reset(struct searchstack *ss, const struct position *restrict pos) {
+    int ply;
+    memcpy(&ss->pos[0], pos, sizeof(ss->pos[0]));
+    nnue_reset(pos);
+    for (ply = 0; ply <= MAX_PLY; ++ply) {
+	ss->frames[ply].killers[0] = 0;
+	ss->frames[ply].killers[1] = 0;
+	ss->frames[ply].npv = 0;
+    }
+    ss->root = 0;
+    ss->keys[0] = pos->hash;
+    return &ss->frames[0];
+}
+
+/*extern*/ void searchstack_set_history(struct searchstack *ss, const uint64_t *keys, int n) {
+    const uint64_t hash = ss->keys[ss->root];
+    if (n > HISTORY_PLIES) {
+	keys += n - HISTORY_PLIES;
+	n = HISTORY_PLIES;
+    }
+    if (n > 0) {
+	memcpy(&ss->keys[0], keys, n * sizeof(keys[0]));
+    }
+    ss->root = n;
+    ss->keys[n] = hash;
+}
@@ -0,0 +1,59 @@
+#ifndef STACK__H_
+#define STACK__H_
+
+#include <stdint.h>
+#include "move.h"
+#include "position.h"
+
+// Per-ply search state.  Perft and search index into one contiguous array of
+// these instead of putting a move list and savepos on the C stack every call,
+// so the hot state for a whole line of play sits in a few adjacent pages.
+//
+// `moves'   - moves generated at this ply
+// `scores'  - ordering scores for `moves'
+// `sp'      - state needed to undo the move made at this ply
+// `killers' - quiet moves that caused a cutoff at this ply
+// `pv'      - principal variation starting at this ply, `npv' moves long
+struct frame {
+    _Alignas(64) move moves[MAX_MOVES];
+    int16_t scores[MAX_MOVES];
+    move killers[2];
+    move pv[MAX_PLY];
+    uint8_t npv;
+    struct savepos sp;
+};
+
+// The 50 move rule means a repetition is never more than 100 plies back, so
+// that is all the game history search needs.
+#define HISTORY_PLIES 128
+
+// `pos' is the position stack walked by MAKE_MOVE/UNDO_MOVE (only one slot
+// unless built with COPY_MAKE), `frames[ply]' is the frame for `ply'.
+// `keys' holds the hashes of the `root' game positions before the root,
+// oldest first, then the current line: `keys[root + ply]' is the hash at
+// `ply'.
+//
+// Move ordering memory for quiet moves, cleared by search():
+// `quiet_history' - butterfly table of how often a move caused a cutoff,
+//                   [side][from][to], kept within +-QUIET_HISTORY_MAX
+// `countermoves'  - last quiet move to refute a move, indexed by that
+//                   move's from and to squares
+#define QUIET_HISTORY_MAX 16384
+struct searchstack {
+    POSITION_STACK(pos);
+    struct frame frames[MAX_PLY + 1];
+    uint64_t keys[HISTORY_PLIES + MAX_PLY + 1];
+    int root;
+    int16_t quiet_history[2][64][64];
+    move countermoves[64 * 64];
+};
+
+// one arena per thread, so helper threads can look at (but not share) it
+extern _Thread_local struct searchstack thread_stack;
+
+extern struct frame *searchstack_reset(struct searchstack *ss, const struct position *restrict pos);
+// game history before `pos' for repetition detection, oldest first; call
+// after searchstack_reset()
+extern void searchstack_set_history(struct searchstack *ss, const uint64_t *keys, int n);
+
+#endif // STACK__H_
@@ -0,0 +1,1172 @@
+#define _GNU_SOURCE
+#include "syzygy.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "movegen.h"
+#include "magic_tables.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+#define WDL_MAGIC 0x5d23e871u
+#define DTZ_MAGIC 0xa50c66d7u
+#define MAX_NAME 16
+// power of two, more than twice the number of tables up to 7 pieces
+#define TABLE_HASH_SIZE 8192
+// rank of a root move, see syzygy_probe_root()
+#define MAX_DTZ (1 << 16)
+
+// flags of a pairs_data
+enum {
+    PD_STM          = 1,
+    PD_MAPPED       = 2,
+    PD_WIN_PLIES    = 4,
+    PD_LOSS_PLIES   = 8,
+    PD_WIDE         = 16,
+    PD_SINGLE_VALUE = 128,
+};
+
+enum {
+    PROBE_FAIL,
+    PROBE_OK,
+    PROBE_CHANGE_STM,   // the DTZ table only has the other side to move
+    PROBE_ZEROING_BEST, // the best move is a capture or pawn move
+};
+
+// One compressed table: the values for one side to move, and with pawns one
+// file of the leading pawn.  The values are Huffman coded "recursive pairs"
+// symbols in fixed size blocks; `sparse_index' points into `block_length'
+// every `span' values so a lookup only walks a few blocks.
+//
+// `pieces'    - piece codes in encoding order, see tb_piece()
+// `group_len' - pieces per group, zero terminated: KRKN is (3, 1)
+// `group_idx' - multiplier of each group's index, the last one is the size
+// `map_idx'   - DTZ value maps for win, loss, cursed win and blessed loss
+struct pairs_data {
+    uint8_t flags;
+    uint8_t max_sym_len;
+    uint8_t min_sym_len;
+    uint32_t nblocks;
+    size_t block_size;
+    size_t span;
+    const uint8_t *lowest_sym;   // uint16_t per symbol length
+    const uint8_t *btree;        // 3 bytes per symbol, the pair it expands to
+    const uint8_t *block_length; // uint16_t per block, values in it minus 1
+    uint32_t block_length_size;
+    const uint8_t *sparse_index; // uint32_t block and uint16_t offset
+    size_t sparse_index_size;
+    const uint8_t *data;
+    uint64_t *base64;            // lowest symbol of each length, left aligned
+    uint8_t *symlen;             // values in each symbol minus 1
+    int nsyms;
+    uint8_t pieces[SYZYGY_MAX_PIECES];
+    uint64_t group_idx[SYZYGY_MAX_PIECES + 1];
+    int group_len[SYZYGY_MAX_PIECES + 1];
+    uint16_t map_idx[4];
+};
+
+// a .rtbw or .rtbz file, mapped by the first probe that needs it
+struct tb_file {
+    _Atomic int ready; // 0 not tried yet, 1 mapped, -1 missing or broken
+    char *path;
+    uint8_t *map;
+    size_t size;
+    const uint8_t *dtz_map;
+    struct pairs_data items[2][4]; // [side to move][file], DTZ only has [0]
+};
+
+// `key'        - material with the first side of the name as white
+// `key2'       - the same with the colours reversed
+// `pawn_count' - [leading colour, other colour], the leading colour is the
+//                one with fewer pawns, white if it's a tie
+struct tb_table {
+    char name[MAX_NAME];
+    uint32_t key;
+    uint32_t key2;
+    int npieces;
+    int has_pawns;
+    int has_unique_pieces;
+    int pawn_count[2];
+    struct tb_file wdl;
+    struct tb_file dtz;
+};
+
+_Thread_local struct syzygy_stats syzygy_stats;
+/*extern*/ int syzygy_max_pieces;
+/*extern*/ int syzygy_search;
+
+static struct tb_table *tables;
+static int ntables;
+static int tables_cap;
+static struct {
+    uint32_t key;
+    int index;
+} table_hash[TABLE_HASH_SIZE];
+static pthread_mutex_t map_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// index tables, see init_indices()
+static int binomial[6][64];
+static int map_b1h1h7[64];
+static int map_a1d1d4[64];
+static int map_kk[10][64];
+static int map_pawns[64];
+static int lead_pawn_idx[6][64];
+static int lead_pawns_size[6][4];
+
+static force_inline uint16_t le16(const uint8_t *p) {
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+static force_inline uint32_t le32(const uint8_t *p) {
+    return le16(p) | (uint32_t)le16(p + 2) << 16;
+}
+
+static force_inline uint32_t be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static force_inline uint64_t be64(const uint8_t *p) {
+    return (uint64_t)be32(p) << 32 | be32(p + 4);
+}
+
+// rank minus file, 0 on the a1-h8 diagonal and negative below it
+static force_inline int off_diagonal(int sq) {
+    return (sq >> 3) - (sq & 7);
+}
+
+// pieces in the files are 1-6 for pawn to king, plus 8 for black
+static force_inline int tb_piece(int pc) {
+    static const uint8_t types[NPIECES] = {
+	[KNIGHT] = 2, [BISHOP] = 3, [ROOK] = 4, [QUEEN] = 5, [PAWN] = 1, [KING] = 6,
+    };
+    return types[pc % NPIECES] | PIECECOLOR(pc) << 3;
+}
+
+static void init_indices(void) {
+    int both[64][2];
+    int diagonal[4];
+    int nboth = 0;
+    int ndiagonal = 0;
+    int code;
+    int lead;
+    int idx;
+    int s1;
+    int s2;
+    int n;
+    int k;
+    int f;
+    int r;
+    int i;
+
+    // b1-h1-h7 triangle below the diagonal to 0..27
+    code = 0;
+    for (s1 = A1; s1 <= H8; ++s1) {
+	if (off_diagonal(s1) < 0) {
+	    map_b1h1h7[s1] = code++;
+	}
+    }
+
+    // a1-d1-d4 triangle to 0..9, the diagonal squares last
+    code = 0;
+    for (s1 = A1; s1 <= D4; ++s1) {
+	if (off_diagonal(s1) < 0 && (s1 & 7) <= FILE_D) {
+	    map_a1d1d4[s1] = code++;
+	} else if (off_diagonal(s1) == 0 && (s1 & 7) <= FILE_D) {
+	    diagonal[ndiagonal++] = s1;
+	}
+    }
+    for (i = 0; i < ndiagonal; ++i) {
+	map_a1d1d4[diagonal[i]] = code++;
+    }
+
+    // the 462 placements of two kings with the first in the a1-d1-d4
+    // triangle, and the second not above the diagonal if the first is on it;
+    // both on the diagonal come last
+    code = 0;
+    for (idx = 0; idx < 10; ++idx) {
+	for (s1 = A1; s1 <= D4; ++s1) {
+	    if (map_a1d1d4[s1] != idx || (idx == 0 && s1 != B1)) {
+		continue;
+	    }
+	    for (s2 = A1; s2 <= H8; ++s2) {
+		if ((king_attacks(s1) | MASK(s1)) & MASK(s2)) {
+		    continue;
+		} else if (off_diagonal(s1) == 0 && off_diagonal(s2) > 0) {
+		    continue;
+		} else if (off_diagonal(s1) == 0 && off_diagonal(s2) == 0) {
+		    both[nboth][0] = idx;
+		    both[nboth++][1] = s2;
+		} else {
+		    map_kk[idx][s2] = code++;
+		}
+	    }
+	}
+    }
+    for (i = 0; i < nboth; ++i) {
+	map_kk[both[i][0]][both[i][1]] = code++;
+    }
+
+    binomial[0][0] = 1;
+    for (n = 1; n < 64; ++n) {
+	for (k = 0; k < 6 && k <= n; ++k) {
+	    binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+	}
+    }
+
+    // map_pawns[] numbers a2-h7 from the edges in, so the leading pawn is the
+    // one with the highest value; each file is its own table so the lead
+    // pawn index restarts at every file
+    code = 47;
+    for (lead = 1; lead <= 5; ++lead) {
+	for (f = FILE_A; f <= FILE_D; ++f) {
+	    idx = 0;
+	    for (r = RANK_2; r <= RANK_7; ++r) {
+		s1 = SQUARE(f, r);
+		if (lead == 1) {
+		    map_pawns[s1] = code--;
+		    map_pawns[s1 ^ 7] = code--;
+		}
+		lead_pawn_idx[lead][s1] = idx;
+		idx += binomial[lead - 1][map_pawns[s1]];
+	    }
+	    lead_pawns_size[lead][f] = idx;
+	}
+    }
+}
+
+static uint32_t material_key(int counts[2][NPIECES], int flip) {
+    uint32_t key = 0;
+    int side;
+    int type;
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= PAWN; ++type) {
+	    key = key * 8 + counts[flip ? FLIP(side) : side][type];
+	}
+    }
+    return key;
+}
+
+static struct tb_table *find_table(uint32_t key) {
+    uint32_t i = (key * 2654435761u) & (TABLE_HASH_SIZE - 1);
+    for (; table_hash[i].index >= 0; i = (i + 1) & (TABLE_HASH_SIZE - 1)) {
+	if (table_hash[i].key == key) {
+	    return &tables[table_hash[i].index];
+	}
+    }
+    return 0;
+}
+
+static void hash_insert(uint32_t key, int index) {
+    uint32_t i = (key * 2654435761u) & (TABLE_HASH_SIZE - 1);
+    while (table_hash[i].index >= 0 && table_hash[i].key != key) {
+	i = (i + 1) & (TABLE_HASH_SIZE - 1);
+    }
+    table_hash[i].key = key;
+    table_hash[i].index = index;
+}
+
+// `name' as in the file names, e.g. KRPvKR: white's pieces then black's,
+// each starting with the king
+static int add_table(const char *name, const char *path, int dtz) {
+    static const char piece_chars[] = "NBRQPK";
+    int counts[2][NPIECES] = {{0}};
+    struct tb_table *t;
+    const char *c;
+    uint32_t key;
+    int npieces = 0;
+    int side = WHITE;
+    int lead;
+    int type;
+    for (c = name; *c; ++c) {
+	if (*c == 'v' && side == WHITE) {
+	    side = BLACK;
+	} else if (*c && strchr(piece_chars, *c)) {
+	    ++counts[side][strchr(piece_chars, *c) - piece_chars];
+	    ++npieces;
+	} else {
+	    return 1;
+	}
+    }
+    if (side != BLACK || counts[WHITE][KING] != 1 || counts[BLACK][KING] != 1 || npieces > SYZYGY_MAX_PIECES) {
+	return 1;
+    }
+    key = material_key(counts, 0);
+    t = find_table(key);
+    if (!t) {
+	if (ntables * 2 >= TABLE_HASH_SIZE / 2) {
+	    return 1;
+	}
+	if (ntables == tables_cap) {
+	    const int cap = tables_cap ? 2 * tables_cap : 256;
+	    struct tb_table *p = realloc(tables, cap * sizeof(*tables));
+	    if (!p) {
+		return 1;
+	    }
+	    tables = p;
+	    tables_cap = cap;
+	}
+	t = &tables[ntables];
+	memset(t, 0, sizeof(*t));
+	snprintf(t->name, sizeof(t->name), "%s", name);
+	t->key = key;
+	t->key2 = material_key(counts, 1);
+	t->npieces = npieces;
+	t->has_pawns = counts[WHITE][PAWN] || counts[BLACK][PAWN];
+	for (side = WHITE; side <= BLACK; ++side) {
+	    for (type = KNIGHT; type <= PAWN; ++type) {
+		t->has_unique_pieces |= counts[side][type] == 1;
+	    }
+	}
+	lead = !counts[BLACK][PAWN] || (counts[WHITE][PAWN] && counts[BLACK][PAWN] >= counts[WHITE][PAWN]) ?
+	    WHITE : BLACK;
+	t->pawn_count[0] = counts[lead][PAWN];
+	t->pawn_count[1] = counts[FLIP(lead)][PAWN];
+	hash_insert(t->key, ntables);
+	hash_insert(t->key2, ntables);
+	++ntables;
+    }
+    if (dtz ? t->dtz.path : t->wdl.path) {
+	return 0; // the first directory in the path wins
+    }
+    if (!(dtz ? (t->dtz.path = strdup(path)) : (t->wdl.path = strdup(path)))) {
+	return 1;
+    }
+    if (!dtz) {
+	syzygy_max_pieces = syzygy_max_pieces > npieces ? syzygy_max_pieces : npieces;
+    }
+    return 0;
+}
+
+/*extern*/ int syzygy_init(const char *path) {
+    static int indices_ready;
+    char file[4096];
+    char name[MAX_NAME];
+    struct dirent *e;
+    char *dirs;
+    char *dir;
+    char *save;
+    size_t len;
+    int nwdl = 0;
+    int i;
+    DIR *d;
+
+    syzygy_free();
+    if (!path || !*path || strcmp(path, "<empty>") == 0) {
+	return 0;
+    }
+    if (!indices_ready) {
+	init_indices();
+	indices_ready = 1;
+    }
+    dirs = strdup(path);
+    if (!dirs) {
+	return 0;
+    }
+    for (dir = strtok_r(dirs, ":", &save); dir; dir = strtok_r(0, ":", &save)) {
+	d = opendir(dir);
+	if (!d) {
+	    fprintf(stderr, "syzygy: can't open '%s'\n", dir);
+	    continue;
+	}
+	while ((e = readdir(d)) != 0) {
+	    len = strlen(e->d_name);
+	    if (len < 6 || len - 5 >= MAX_NAME ||
+		(strcmp(e->d_name + len - 5, ".rtbw") != 0 && strcmp(e->d_name + len - 5, ".rtbz") != 0)) {
+		continue;
+	    }
+	    memcpy(name, e->d_name, len - 5);
+	    name[len - 5] = 0;
+	    snprintf(file, sizeof(file), "%s/%s", dir, e->d_name);
+	    add_table(name, file, e->d_name[len - 1] == 'z');
+	}
+	closedir(d);
+    }
+    free(dirs);
+    for (i = 0; i < ntables; ++i) {
+	nwdl += tables[i].wdl.path != 0;
+    }
+    return nwdl;
+}
+
+static void file_free(struct tb_file *restrict f) {
+    int i;
+    int j;
+    if (f->map) {
+	munmap(f->map, f->size);
+    }
+    for (i = 0; i < 2; ++i) {
+	for (j = 0; j < 4; ++j) {
+	    free(f->items[i][j].base64);
+	    free(f->items[i][j].symlen);
+	}
+    }
+    free(f->path);
+}
+
+/*extern*/ void syzygy_free(void) {
+    int i;
+    for (i = 0; i < ntables; ++i) {
+	file_free(&tables[i].wdl);
+	file_free(&tables[i].dtz);
+    }
+    free(tables);
+    tables = 0;
+    ntables = 0;
+    tables_cap = 0;
+    for (i = 0; i < TABLE_HASH_SIZE; ++i) {
+	table_hash[i].index = -1;
+    }
+    syzygy_max_pieces = 0;
+}
+
+//
+// Table layout
+//
+
+static force_inline int btree_left(const struct pairs_data *restrict d, int sym) {
+    const uint8_t *lr = d->btree + 3 * sym;
+    return (lr[1] & 0xf) << 8 | lr[0];
+}
+
+static force_inline int btree_right(const struct pairs_data *restrict d, int sym) {
+    const uint8_t *lr = d->btree + 3 * sym;
+    return lr[2] << 4 | lr[1] >> 4;
+}
+
+// values a symbol expands to, minus 1; the pair tree is acyclic
+static int set_symlen(struct pairs_data *restrict d, int sym, uint8_t *restrict visited) {
+    int left;
+    int right;
+    visited[sym] = 1;
+    right = btree_right(d, sym);
+    if (right == 0xfff) {
+	return 0;
+    }
+    left = btree_left(d, sym);
+    if (!visited[left]) {
+	d->symlen[left] = set_symlen(d, left, visited);
+    }
+    if (!visited[right]) {
+	d->symlen[right] = set_symlen(d, right, visited);
+    }
+    return d->symlen[left] + d->symlen[right] + 1;
+}
+
+// The position index is g1 * N(g2) * N(g3) + g2 * N(g3) + g3 for groups of
+// pieces g1, g2, ... but the groups are multiplied out in the order the file
+// gives, the leading pawns or pieces at `order[0]' and the other side's
+// pawns at `order[1]'.
+static void set_groups(const struct tb_table *restrict t, struct pairs_data *restrict d, const int order[2], int file) {
+    const int pp = t->has_pawns && t->pawn_count[1];
+    int first_len = t->has_pawns ? 0 : t->has_unique_pieces ? 3 : 2;
+    int free_squares;
+    uint64_t idx = 1;
+    int next = pp ? 2 : 1;
+    int n = 0;
+    int i;
+    int k;
+    d->group_len[n] = 1;
+    for (i = 1; i < t->npieces; ++i) {
+	if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) {
+	    ++d->group_len[n];
+	} else {
+	    d->group_len[++n] = 1;
+	}
+    }
+    d->group_len[++n] = 0;
+
+    free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    for (k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+	if (k == order[0]) {
+	    d->group_idx[0] = idx;
+	    idx *= t->has_pawns ? lead_pawns_size[d->group_len[0]][file] : t->has_unique_pieces ? 31332 : 462;
+	} else if (k == order[1]) {
+	    d->group_idx[1] = idx;
+	    idx *= binomial[d->group_len[1]][48 - d->group_len[0]];
+	} else {
+	    d->group_idx[next] = idx;
+	    idx *= binomial[d->group_len[next]][free_squares];
+	    free_squares -= d->group_len[next++];
+	}
+    }
+    d->group_idx[n] = idx;
+}
+
+// Canonical Huffman code: longer symbols have lower values, so base64[]
+// holds the lowest symbol of each length padded to 64 bits and the length
+// of the next symbol is the first with base64[len] <= the next 64 bits.
+static const uint8_t *set_sizes(struct pairs_data *restrict d, const uint8_t *data) {
+    uint8_t *visited;
+    uint64_t size;
+    int nbase;
+    int padding;
+    int i;
+
+    d->flags = *data++;
+    if (d->flags & PD_SINGLE_VALUE) {
+	d->min_sym_len = *data++; // the value of every position
+	return data;
+    }
+    for (i = 0; d->group_len[i]; ++i) {
+    }
+    size = d->group_idx[i];
+    d->block_size = (size_t)1 << *data++;
+    d->span = (size_t)1 << *data++;
+    d->sparse_index_size = (size + d->span - 1) / d->span;
+    padding = *data++;
+    d->nblocks = le32(data);
+    data += 4;
+    // padded so the sparse index can't point past the end
+    d->block_length_size = d->nblocks + padding;
+    d->max_sym_len = *data++;
+    d->min_sym_len = *data++;
+    d->lowest_sym = data;
+    nbase = d->max_sym_len - d->min_sym_len + 1;
+    d->base64 = calloc(nbase, sizeof(d->base64[0]));
+    if (!d->base64) {
+	return 0;
+    }
+    for (i = nbase - 2; i >= 0; --i) {
+	d->base64[i] = (d->base64[i + 1] + le16(d->lowest_sym + 2 * i) - le16(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for (i = 0; i < nbase; ++i) {
+	d->base64[i] <<= 64 - i - d->min_sym_len;
+    }
+    data += 2 * nbase;
+
+    d->nsyms = le16(data);
+    data += 2;
+    d->btree = data;
+    d->symlen = calloc(d->nsyms, 1);
+    visited = calloc(d->nsyms, 1);
+    if (!d->symlen || !visited) {
+	free(visited);
+	return 0;
+    }
+    for (i = 0; i < d->nsyms; ++i) {
+	if (!visited[i]) {
+	    d->symlen[i] = set_symlen(d, i, visited);
+	}
+    }
+    free(visited);
+    return data + 3 * d->nsyms + (d->nsyms & 1);
+}
+
+// DTZ values can be mapped through a per-file table for each result
+static const uint8_t *set_dtz_map(struct tb_file *restrict f, const uint8_t *data, int nfiles) {
+    struct pairs_data *d;
+    int file;
+    int i;
+    f->dtz_map = data;
+    for (file = 0; file < nfiles; ++file) {
+	d = &f->items[0][file];
+	if (!(d->flags & PD_MAPPED)) {
+	    continue;
+	}
+	if (d->flags & PD_WIDE) {
+	    data += (data - f->map) & 1;
+	    for (i = 0; i < 4; ++i) {
+		d->map_idx[i] = (data - f->dtz_map) / 2 + 1;
+		data += 2 * le16(data) + 2;
+	    }
+	} else {
+	    for (i = 0; i < 4; ++i) {
+		d->map_idx[i] = data - f->dtz_map + 1;
+		data += *data + 1;
+	    }
+	}
+    }
+    return data + ((data - f->map) & 1);
+}
+
+static int init_file(const struct tb_table *restrict t, struct tb_file *restrict f, int dtz) {
+    const int sides = !dtz && t->key != t->key2 ? 2 : 1;
+    const int nfiles = t->has_pawns ? 4 : 1;
+    const int pp = t->has_pawns && t->pawn_count[1];
+    const uint8_t *data = f->map + 4;
+    struct pairs_data *d;
+    int order[2][2];
+    int file;
+    int i;
+    int k;
+
+    ++data; // flags, known from the name
+    for (file = 0; file < nfiles; ++file) {
+	order[0][0] = data[0] & 0xf;
+	order[0][1] = pp ? data[1] & 0xf : 0xf;
+	order[1][0] = data[0] >> 4;
+	order[1][1] = pp ? data[1] >> 4 : 0xf;
+	data += 1 + pp;
+	for (k = 0; k < t->npieces; ++k, ++data) {
+	    for (i = 0; i < sides; ++i) {
+		f->items[i][file].pieces[k] = i ? *data >> 4 : *data & 0xf;
+	    }
+	}
+	for (i = 0; i < sides; ++i) {
+	    set_groups(t, &f->items[i][file], order[i], file);
+	}
+    }
+    data += (data - f->map) & 1;
+
+    for (file = 0; file < nfiles; ++file) {
+	for (i = 0; i < sides; ++i) {
+	    data = set_sizes(&f->items[i][file], data);
+	    if (!data) {
+		return 1;
+	    }
+	}
+    }
+    if (dtz) {
+	data = set_dtz_map(f, data, nfiles);
+    }
+    for (file = 0; file < nfiles; ++file) {
+	for (i = 0; i < sides; ++i) {
+	    d = &f->items[i][file];
+	    d->sparse_index = data;
+	    data += 6 * d->sparse_index_size;
+	}
+    }
+    for (file = 0; file < nfiles; ++file) {
+	for (i = 0; i < sides; ++i) {
+	    d = &f->items[i][file];
+	    d->block_length = data;
+	    data += 2 * d->block_length_size;
+	}
+    }
+    for (file = 0; file < nfiles; ++file) {
+	for (i = 0; i < sides; ++i) {
+	    d = &f->items[i][file];
+	    data = f->map + (((data - f->map) + 63) & ~(ptrdiff_t)63);
+	    d->data = data;
+	    data += (size_t)d->nblocks * d->block_size;
+	}
+    }
+    return data > f->map + f->size;
+}
+
+static int map_file(const struct tb_table *restrict t, struct tb_file *restrict f, int dtz) {
+    struct stat st;
+    int fd;
+    if (!f->path) {
+	return 1;
+    }
+    fd = open(f->path, O_RDONLY);
+    if (fd < 0) {
+	return 1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size % 64 != 16) {
+	fprintf(stderr, "syzygy: '%s' is corrupt\n", f->path);
+	close(fd);
+	return 1;
+    }
+    f->map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (f->map == MAP_FAILED) {
+	f->map = 0;
+	return 1;
+    }
+    f->size = st.st_size;
+    madvise(f->map, f->size, MADV_RANDOM);
+    if (le32(f->map) != (dtz ? DTZ_MAGIC : WDL_MAGIC) || init_file(t, f, dtz) != 0) {
+	fprintf(stderr, "syzygy: '%s' is corrupt\n", f->path);
+	return 1;
+    }
+    return 0;
+}
+
+static int file_ready(const struct tb_table *restrict t, struct tb_file *restrict f, int dtz) {
+    int ready = atomic_load_explicit(&f->ready, memory_order_acquire);
+    if (ready) {
+	return ready > 0;
+    }
+    pthread_mutex_lock(&map_mutex);
+    ready = atomic_load_explicit(&f->ready, memory_order_relaxed);
+    if (!ready) {
+	ready = map_file(t, f, dtz) == 0 ? 1 : -1;
+	atomic_store_explicit(&f->ready, ready, memory_order_release);
+    }
+    pthread_mutex_unlock(&map_mutex);
+    return ready > 0;
+}
+
+//
+// Probing
+//
+
+static int decompress_pairs(const struct pairs_data *restrict d, uint64_t idx) {
+    const uint8_t *ptr;
+    uint32_t block;
+    uint64_t k;
+    uint64_t buf;
+    int buf_size;
+    int offset;
+    int len;
+    int sym;
+    int left;
+
+    if (d->flags & PD_SINGLE_VALUE) {
+	return d->min_sym_len;
+    }
+
+    // sparse index entry k is for the value at k * span + span / 2, from
+    // there walk to the block holding `idx'
+    k = idx / d->span;
+    block = le32(d->sparse_index + 6 * k);
+    offset = le16(d->sparse_index + 6 * k + 4);
+    offset += (int)(idx % d->span) - (int)(d->span / 2);
+    while (offset < 0) {
+	offset += le16(d->block_length + 2 * --block) + 1;
+    }
+    while (offset > le16(d->block_length + 2 * block)) {
+	offset -= le16(d->block_length + 2 * block++) + 1;
+    }
+
+    // skip whole symbols until the one covering `offset'
+    ptr = d->data + (uint64_t)block * d->block_size;
+    buf = be64(ptr);
+    ptr += 8;
+    buf_size = 64;
+    for (;;) {
+	len = 0;
+	while (buf < d->base64[len]) {
+	    ++len;
+	}
+	sym = (buf - d->base64[len]) >> (64 - len - d->min_sym_len);
+	sym += le16(d->lowest_sym + 2 * len);
+	if (offset < d->symlen[sym] + 1) {
+	    break;
+	}
+	offset -= d->symlen[sym] + 1;
+	len += d->min_sym_len;
+	buf <<= len;
+	buf_size -= len;
+	if (buf_size <= 32) {
+	    buf_size += 32;
+	    buf |= (uint64_t)be32(ptr) << (64 - buf_size);
+	    ptr += 4;
+	}
+    }
+
+    // then down the pair tree to the single value
+    while (d->symlen[sym]) {
+	left = btree_left(d, sym);
+	if (offset < d->symlen[left] + 1) {
+	    sym = left;
+	} else {
+	    offset -= d->symlen[left] + 1;
+	    sym = btree_right(d, sym);
+	}
+    }
+    return btree_left(d, sym);
+}
+
+static int dtz_map_score(const struct tb_file *restrict f, const struct pairs_data *restrict d, int value, int wdl) {
+    static const int wdl_map[] = { 1, 3, 0, 2, 0 };
+    int idx;
+    if (d->flags & PD_MAPPED) {
+	idx = d->map_idx[wdl_map[wdl + 2]];
+	value = d->flags & PD_WIDE ? le16(f->dtz_map + 2 * (idx + value)) : f->dtz_map[idx + value];
+    }
+    // stored in moves unless the flags say plies
+    if ((wdl == SYZYGY_WIN && !(d->flags & PD_WIN_PLIES)) || (wdl == SYZYGY_LOSS && !(d->flags & PD_LOSS_PLIES)) ||
+	wdl == SYZYGY_CURSED_WIN || wdl == SYZYGY_BLESSED_LOSS) {
+	value *= 2;
+    }
+    return value + 1;
+}
+
+static void sort_squares(uint8_t *restrict squares, int n, const int *restrict by) {
+    uint8_t sq;
+    int i;
+    int j;
+    for (i = 1; i < n; ++i) {
+	sq = squares[i];
+	for (j = i; j > 0 && (by ? by[squares[j - 1]] > by[sq] : squares[j - 1] > sq); --j) {
+	    squares[j] = squares[j - 1];
+	}
+	squares[j] = sq;
+    }
+}
+
+// The WDL value, or with `dtz' the DTZ value for a position whose WDL is
+// `wdl'.  The position is read into squares and piece codes in the file's
+// order: colours swapped if the table has the other side as white, then
+// mirrored so the leading piece is in the a1-d1-d4 triangle, or the leading
+// pawn on files a-d.
+static int probe_table(const struct position *restrict pos, int dtz, int wdl, int *result) {
+    uint8_t squares[SYZYGY_MAX_PIECES];
+    uint8_t pieces[SYZYGY_MAX_PIECES];
+    int counts[2][NPIECES];
+    const struct pairs_data *d;
+    struct tb_table *t;
+    struct tb_file *f;
+    uint64_t lead_pawns = 0;
+    uint64_t idx;
+    uint64_t bb;
+    uint32_t key;
+    int flip;
+    int flip_color;
+    int flip_squares;
+    int stm;
+    int lead_count = 0;
+    int size = 0;
+    int file = 0;
+    int remaining_pawns;
+    int next;
+    int group;
+    int adjust;
+    int side;
+    int type;
+    int tmp;
+    int i;
+    int j;
+
+    for (side = WHITE; side <= BLACK; ++side) {
+	for (type = KNIGHT; type <= KING; ++type) {
+	    counts[side][type] = popcountll(PIECES(*pos, side, type));
+	}
+    }
+    key = material_key(counts, 0);
+    if (key == 0) {
+	return SYZYGY_DRAW; // bare kings
+    }
+    ++syzygy_stats.probes;
+    t = find_table(key);
+    f = t ? (dtz ? &t->dtz : &t->wdl) : 0;
+    if (!f || !file_ready(t, f, dtz)) {
+	*result = PROBE_FAIL;
+	return 0;
+    }
+    ++syzygy_stats.hits;
+
+    // symmetric tables only have white to move
+    flip = (t->key == t->key2 && pos->wtm == BLACK) || key != t->key;
+    flip_color = flip ? 8 : 0;
+    flip_squares = flip ? 56 : 0;
+    stm = flip ^ pos->wtm;
+
+    // the leading pawn is the one nearest the edge and then the lowest rank,
+    // which picks the file's table
+    if (t->has_pawns) {
+	const int pc = f->items[0][0].pieces[0] ^ flip_color;
+	lead_pawns = bb = PIECES(*pos, pc >> 3, PAWN);
+	do {
+	    squares[size++] = lsb(bb) ^ flip_squares;
+	    clear_lsb(bb);
+	} while (bb);
+	lead_count = size;
+	for (i = 1, j = 0; i < lead_count; ++i) {
+	    j = map_pawns[squares[i]] > map_pawns[squares[j]] ? i : j;
+	}
+	tmp = squares[0], squares[0] = squares[j], squares[j] = tmp;
+	file = MIN(squares[0] & 7, 7 - (squares[0] & 7));
+    }
+
+    // DTZ tables only have one side to move
+    if (dtz && (f->items[0][file].flags & PD_STM) != stm && !(t->key == t->key2 && !t->has_pawns)) {
+	*result = PROBE_CHANGE_STM;
+	return 0;
+    }
+
+    bb = (pos->side[WHITE] | pos->side[BLACK]) ^ lead_pawns;
+    do {
+	i = lsb(bb);
+	clear_lsb(bb);
+	squares[size] = i ^ flip_squares;
+	pieces[size++] = tb_piece(pos->sqtopc[i]) ^ flip_color;
+    } while (bb);
+
+    d = &f->items[dtz ? 0 : stm][file];
+    for (i = lead_count; i < size - 1; ++i) {
+	for (j = i + 1; j < size; ++j) {
+	    if (d->pieces[i] == pieces[j]) {
+		tmp = pieces[i], pieces[i] = pieces[j], pieces[j] = tmp;
+		tmp = squares[i], squares[i] = squares[j], squares[j] = tmp;
+		break;
+	    }
+	}
+    }
+
+    if ((squares[0] & 7) > FILE_D) {
+	for (i = 0; i < size; ++i) {
+	    squares[i] ^= 7;
+	}
+    }
+
+    if (t->has_pawns) {
+	idx = lead_pawn_idx[lead_count][squares[0]];
+	sort_squares(squares + 1, lead_count - 1, map_pawns);
+	for (i = 1; i < lead_count; ++i) {
+	    idx += binomial[i][map_pawns[squares[i]]];
+	}
+    } else {
+	// without pawns also mirror the leading piece below rank 5, and then
+	// the first of the leading group off the diagonal below it
+	if ((squares[0] >> 3) > RANK_4) {
+	    for (i = 0; i < size; ++i) {
+		squares[i] ^= 56;
+	    }
+	}
+	for (i = 0; i < d->group_len[0]; ++i) {
+	    if (off_diagonal(squares[i]) == 0) {
+		continue;
+	    }
+	    if (off_diagonal(squares[i]) > 0) {
+		for (j = i; j < size; ++j) {
+		    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+		}
+	    }
+	    break;
+	}
+
+	if (t->has_unique_pieces) {
+	    // three unique pieces together, 31332 ways
+	    const int adjust1 = squares[1] > squares[0];
+	    const int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+	    if (off_diagonal(squares[0])) {
+		idx = (map_a1d1d4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+	    } else if (off_diagonal(squares[1])) {
+		idx = (6 * 63 + (squares[0] >> 3) * 28 + map_b1h1h7[squares[1]]) * 62 + squares[2] - adjust2;
+	    } else if (off_diagonal(squares[2])) {
+		idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 +
+		    ((squares[1] >> 3) - adjust1) * 28 + map_b1h1h7[squares[2]];
+	    } else {
+		idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 +
+		    ((squares[1] >> 3) - adjust1) * 6 + ((squares[2] >> 3) - adjust2);
+	    }
+	} else {
+	    // just the kings, 462 ways
+	    idx = map_kk[map_a1d1d4[squares[0]]][squares[1]];
+	}
+    }
+
+    // the other groups by their squares in ascending order, each skipping
+    // the squares taken by earlier groups
+    idx *= d->group_idx[0];
+    group = d->group_len[0];
+    remaining_pawns = t->has_pawns && t->pawn_count[1];
+    for (next = 1; d->group_len[next]; ++next) {
+	uint64_t n = 0;
+	sort_squares(squares + group, d->group_len[next], 0);
+	for (i = 0; i < d->group_len[next]; ++i) {
+	    for (adjust = 0, j = 0; j < group; ++j) {
+		adjust += squares[group + i] > squares[j];
+	    }
+	    n += binomial[i + 1][squares[group + i] - adjust - 8 * remaining_pawns];
+	}
+	remaining_pawns = 0;
+	idx += n * d->group_idx[next];
+	group += d->group_len[next];
+    }
+
+    i = decompress_pairs(d, idx);
+    return dtz ? dtz_map_score(f, d, i, wdl) : i - 2;
+}
+
+static force_inline int is_capture(const struct position *restrict pos, move m) {
+    return pos->sqtopc[TO(m)] != EMPTY || FLAGS(m) == FLG_EP;
+}
+
+// WDL after resolving captures, which the table may store as "don't care";
+// with `zeroing' pawn moves too, for a DTZ probe
+static int search_captures(struct position *restrict pos, int zeroing, int *result) {
+    move moves[MAX_MOVES];
+    struct savepos sp;
+    const int nmoves = generate_legal_moves(pos, &moves[0]);
+    int best = SYZYGY_LOSS;
+    int count = 0;
+    int all_searched;
+    int value;
+    int i;
+    for (i = 0; i < nmoves; ++i) {
+	if (!is_capture(pos, moves[i]) && (!zeroing || pos->sqtopc[FROM(moves[i])] % NPIECES != PAWN)) {
+	    continue;
+	}
+	++count;
+	make_move(pos, &sp, moves[i]);
+	value = -search_captures(pos, 0, result);
+	undo_move(pos, &sp, moves[i]);
+	if (*result == PROBE_FAIL) {
+	    return SYZYGY_DRAW;
+	}
+	if (value > best) {
+	    best = value;
+	    if (value >= SYZYGY_WIN) {
+		*result = PROBE_ZEROING_BEST;
+		return value;
+	    }
+	}
+    }
+
+    // with every move searched the table isn't needed, and could be wrong
+    all_searched = count && count == nmoves;
+    if (all_searched) {
+	value = best;
+    } else {
+	value = probe_table(pos, 0, 0, result);
+	if (*result == PROBE_FAIL) {
+	    return SYZYGY_DRAW;
+	}
+    }
+    if (best >= value) {
+	*result = best > SYZYGY_DRAW || all_searched ? PROBE_ZEROING_BEST : PROBE_OK;
+	return best;
+    }
+    *result = PROBE_OK;
+    return value;
+}
+
+static force_inline int dtz_before_zeroing(int wdl) {
+    switch (wdl) {
+    case SYZYGY_WIN: return 1;
+    case SYZYGY_CURSED_WIN: return 101;
+    case SYZYGY_BLESSED_LOSS: return -101;
+    case SYZYGY_LOSS: return -1;
+    default: return 0;
+    }
+}
+
+static int probe_dtz(struct position *restrict pos, int *result) {
+    move moves[MAX_MOVES];
+    struct savepos sp;
+    int min_dtz = 0xffff;
+    int zeroing;
+    int nmoves;
+    int wdl;
+    int dtz;
+    int i;
+
+    *result = PROBE_OK;
+    wdl = search_captures(pos, 1, result);
+    if (*result == PROBE_FAIL || wdl == SYZYGY_DRAW) {
+	return 0; // draws aren't stored
+    }
+    if (*result == PROBE_ZEROING_BEST) {
+	return dtz_before_zeroing(wdl);
+    }
+    dtz = probe_table(pos, 1, wdl, result);
+    if (*result == PROBE_FAIL) {
+	return 0;
+    }
+    if (*result != PROBE_CHANGE_STM) {
+	return (dtz + 100 * (wdl == SYZYGY_BLESSED_LOSS || wdl == SYZYGY_CURSED_WIN)) * (wdl > 0 ? 1 : -1);
+    }
+
+    // the table is for the other side to move, so take the best reply
+    nmoves = generate_legal_moves(pos, &moves[0]);
+    for (i = 0; i < nmoves; ++i) {
+	zeroing = is_capture(pos, moves[i]) || pos->sqtopc[FROM(moves[i])] % NPIECES == PAWN;
+	make_move(pos, &sp, moves[i]);
+	// for a zeroing move the DTZ is of the move itself, the search only
+	// tells whether it wins
+	dtz = zeroing ? -dtz_before_zeroing(search_captures(pos, 0, result)) : -probe_dtz(pos, result);
+	if (dtz == 1 && generate_checkers(pos, pos->wtm) && !has_legal_move(pos)) {
+	    min_dtz = 1; // mate
+	}
+	if (!zeroing) {
+	    dtz += dtz > 0 ? 1 : dtz < 0 ? -1 : 0;
+	}
+	if (dtz < min_dtz && (dtz > 0) == (wdl > 0) && dtz != 0) {
+	    min_dtz = dtz;
+	}
+	undo_move(pos, &sp, moves[i]);
+	if (*result == PROBE_FAIL) {
+	    return 0;
+	}
+    }
+    return min_dtz == 0xffff ? -1 : min_dtz;
+}
+
+static force_inline int probeable(const struct position *restrict pos) {
+    return syzygy_max_pieces && pos->castle == CSL_NONE &&
+	popcountll(pos->side[WHITE] | pos->side[BLACK]) <= syzygy_max_pieces;
+}
+
+/*extern*/ int syzygy_probe_wdl(struct position *restrict pos, int *ok) {
+    int result = PROBE_OK;
+    int wdl;
+    if (!probeable(pos)) {
+	*ok = 0;
+	return SYZYGY_DRAW;
+    }
+    wdl = search_captures(pos, 0, &result);
+    *ok = result != PROBE_FAIL;
+    return wdl;
+}
+
+/*extern*/ int syzygy_probe_dtz(struct position *restrict pos, int *ok) {
+    int result = PROBE_OK;
+    int dtz;
+    if (!probeable(pos)) {
+	*ok = 0;
+	return 0;
+    }
+    dtz = probe_dtz(pos, &result);
+    *ok = result != PROBE_FAIL;
+    return dtz;
+}
+
+// Wins the 50 move rule allows rank first, the fewest plies to a zeroing
+// move first, then cursed wins, draws, blessed losses and real losses, the
+// most plies first.  Repetitions in the game aren't looked at.
+/*extern*/ move syzygy_probe_root(struct position *restrict pos, int *dtz) {
+    move moves[MAX_MOVES];
+    struct savepos sp;
+    const int halfmoves = pos->halfmoves;
+    int result = PROBE_OK;
+    int best_rank = INT_MIN;
+    move best = 0;
+    int nmoves;
+    int value;
+    int rank;
+    int i;
+
+    if (!probeable(pos)) {
+	return 0;
+    }
+    nmoves = generate_legal_moves(pos, &moves[0]);
+    for (i = 0; i < nmoves; ++i) {
+	make_move(pos, &sp, moves[i]);
+	if (pos->halfmoves == 0) {
+	    value = dtz_before_zeroing(-search_captures(pos, 0, &result));
+	} else {
+	    value = -probe_dtz(pos, &result);
+	    value += value > 0 ? 1 : value < 0 ? -1 : 0;
+	}
+	if (value == 2 && generate_checkers(pos, pos->wtm) && !has_legal_move(pos)) {
+	    value = 1;
+	}
+	undo_move(pos, &sp, moves[i]);
+	if (result == PROBE_FAIL) {
+	    return 0;
+	}
+	if (value > 0) {
+	    rank = (value + halfmoves <= 99 ? 3 * MAX_DTZ : 2 * MAX_DTZ) - value;
+	} else if (value < 0) {
+	    rank = (-value + halfmoves <= 99 ? -3 * MAX_DTZ : -2 * MAX_DTZ) - value;
+	} else {
+	    rank = 0;
+	}
+	if (rank > best_rank) {
+	    best_rank = rank;
+	    best = moves[i];
+	    *dtz = value;
+	}
+    }
+    return best;
+}
+
+/*extern*/ void syzygy_stats_print(FILE *os) {
+    fprintf(os, "syzygy: probes = %" PRIu64 ", hits = %" PRIu64 " (%.1f%%)\n",
+	    syzygy_stats.probes, syzygy_stats.hits,
+	    syzygy_stats.probes ? 100.0 * syzygy_stats.hits / syzygy_stats.probes : 0.0);
+}
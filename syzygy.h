@@ -0,0 +1,64 @@
+#ifndef SYZYGY__H_
+#define SYZYGY__H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "move.h"
+#include "position.h"
+
+// Probing of Syzygy WDL (.rtbw) and DTZ (.rtbz) tablebases from local files.
+//
+// syzygy_init() only scans the directories for file names, a table is
+// mmap()ed the first time a position with its material is probed.  Probes
+// read the squares straight from `struct position' into arrays on the stack,
+// nothing is allocated per probe.
+//
+// The tables don't cover castling rights, so positions with any are never
+// probed.  The WDL tables store "don't care" values where a capture or en
+// passant is the best move, so a probe first searches the captures, which
+// make/undo on `pos' and leave it as it was.
+#define SYZYGY_MAX_PIECES 7
+
+// results for the side to move, a cursed win is a win that the 50 move rule
+// turns into a draw and a blessed loss the other way around
+enum {
+    SYZYGY_LOSS = -2,
+    SYZYGY_BLESSED_LOSS = -1,
+    SYZYGY_DRAW = 0,
+    SYZYGY_CURSED_WIN = 1,
+    SYZYGY_WIN = 2,
+};
+
+// `probes' - WDL and DTZ tables read, `hits' - of those, how many had the table
+struct syzygy_stats {
+    uint64_t probes;
+    uint64_t hits;
+};
+
+extern _Thread_local struct syzygy_stats syzygy_stats;
+
+// most pieces, kings included, of any table found, 0 without tables
+extern int syzygy_max_pieces;
+// search() only probes the tables, at the root and in the tree, when this
+// is set (xboard's SyzygySearch option).  Off by default: the block decoder
+// has only been checked against stub tables so far, see `chess check-syzygy'.
+extern int syzygy_search;
+
+// `path' is a list of directories separated by ':', "" or "<empty>" for none.
+// Unmaps the tables of any previous path.  Returns the number of tables.
+extern int syzygy_init(const char *path);
+extern void syzygy_free(void);
+
+// Set `*ok' to 0 if the position couldn't be probed.
+extern int syzygy_probe_wdl(struct position *restrict pos, int *ok);
+// Plies to the next capture or pawn move in the best line, positive when the
+// side to move wins, with 100 added for cursed wins and blessed losses.
+extern int syzygy_probe_dtz(struct position *restrict pos, int *ok);
+// The move that keeps the best result with the fewest plies to a zeroing
+// move when winning and the most when losing, 0 if the position can't be
+// probed.  `*dtz' is the DTZ after it, from the root side's point of view.
+extern move syzygy_probe_root(struct position *restrict pos, int *dtz);
+
+extern void syzygy_stats_print(FILE *os);
+
+#endif // SYZYGY__H_
@@ -0,0 +1,102 @@
+#include "tt.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "alloc.h"
+
+struct tt tt;
+_Thread_local struct tt_stats tt_stats;
+
+/*extern*/ int tt_init(size_t mb) {
+    size_t nbuckets = 1;
+    tt_destroy();
+    // round down to a power of two number of buckets
+    while (nbuckets * 2 * sizeof(struct tt_bucket) <= (mb << 20)) {
+	nbuckets *= 2;
+    }
+    tt.size = nbuckets * sizeof(struct tt_bucket);
+    // fresh anonymous mappings are already zeroed, so don't touch the pages here
+    tt.buckets = large_alloc(tt.size, "transposition table");
+    if (!tt.buckets) {
+	tt.size = 0;
+	return 1;
+    }
+    tt.mask = nbuckets - 1;
+    return 0;
+}
+
+/*extern*/ void tt_destroy(void) {
+    large_free(tt.buckets, tt.size);
+    memset(&tt, 0, sizeof(tt));
+}
+
+/*extern*/ void tt_clear(void) {
+    if (tt.buckets) {
+	memset(tt.buckets, 0, tt.size);
+    }
+}
+
+/*extern*/ int tt_probe(uint64_t key, struct tt_entry *restrict out) {
+    const struct tt_bucket *bucket;
+    const int prefetched = key == tt_stats.prefetch_key;
+    int i;
+    if (!tt.buckets) {
+	return 0;
+    }
+    ++tt_stats.probes;
+    if (prefetched) {
+	++tt_stats.prefetch_probes;
+	tt_stats.prefetch_key = 0;
+    }
+    bucket = &tt.buckets[key & tt.mask];
+    for (i = 0; i < TT_BUCKET_SIZE; ++i) {
+	if (bucket->entries[i].key == key && bucket->entries[i].bound != TT_NONE) {
+	    memcpy(out, &bucket->entries[i], sizeof(*out));
+	    ++tt_stats.hits;
+	    tt_stats.prefetch_hits += prefetched;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*extern*/ void tt_store(uint64_t key, move m, int score, int depth, int bound) {
+    struct tt_bucket *bucket;
+    struct tt_entry *replace;
+    int i;
+    if (!tt.buckets) {
+	return;
+    }
+    ++tt_stats.stores;
+    bucket = &tt.buckets[key & tt.mask];
+    // same position, else an empty slot, else the shallowest entry
+    replace = &bucket->entries[0];
+    for (i = 0; i < TT_BUCKET_SIZE; ++i) {
+	if (bucket->entries[i].key == key || bucket->entries[i].bound == TT_NONE) {
+	    replace = &bucket->entries[i];
+	    break;
+	}
+	if (bucket->entries[i].depth < replace->depth) {
+	    replace = &bucket->entries[i];
+	}
+    }
+    // keep the old best move if we don't have one
+    if (m || replace->key != key) {
+	replace->m = m;
+    }
+    replace->key = key;
+    replace->score = score;
+    replace->depth = depth;
+    replace->bound = bound;
+}
+
+/*extern*/ void tt_stats_print(FILE *os) {
+    fprintf(os, "tt: %zu MB, probes = %" PRIu64 ", hits = %" PRIu64 " (%.1f%%), stores = %" PRIu64 "\n",
+	    tt.size >> 20, tt_stats.probes, tt_stats.hits,
+	    tt_stats.probes ? 100.0 * tt_stats.hits / tt_stats.probes : 0.0, tt_stats.stores);
+    fprintf(os, "tt: prefetches = %" PRIu64 ", probed = %" PRIu64 " (%.1f%%), hits = %" PRIu64 " (%.1f%%)\n",
+	    tt_stats.prefetches, tt_stats.prefetch_probes,
+	    tt_stats.prefetches ? 100.0 * tt_stats.prefetch_probes / tt_stats.prefetches : 0.0,
+	    tt_stats.prefetch_hits,
+	    tt_stats.prefetch_probes ? 100.0 * tt_stats.prefetch_hits / tt_stats.prefetch_probes : 0.0);
+}
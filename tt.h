@@ -0,0 +1,72 @@
+#ifndef TT__H_
+#define TT__H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "move.h"
+
+// Transposition table: 64 byte buckets of 4 entries indexed by the low bits
+// of the position hash.  The table lives in large_alloc()'d memory and is
+// shared; the stats are per thread.
+
+enum {
+    TT_NONE,
+    TT_UPPER, // score is an upper bound (failed low)
+    TT_LOWER, // score is a lower bound (failed high)
+    TT_EXACT,
+};
+
+struct tt_entry {
+    uint64_t key;
+    move     m;
+    int16_t  score;
+    int8_t   depth;
+    uint8_t  bound;
+};
+
+#define DEFAULT_HASH_MB 64
+
+#define TT_BUCKET_SIZE 4
+struct tt_bucket {
+    _Alignas(64) struct tt_entry entries[TT_BUCKET_SIZE];
+};
+
+struct tt {
+    struct tt_bucket *buckets;
+    uint64_t mask;
+    size_t size; // in bytes
+};
+
+// `prefetch_probes' - prefetches whose position was probed before the next
+//                     one, the rest were wasted
+// `prefetch_hits' - those probes that found an entry
+struct tt_stats {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t prefetches;
+    uint64_t prefetch_probes;
+    uint64_t prefetch_hits;
+    uint64_t prefetch_key; // 0 once probed
+};
+
+extern struct tt tt;
+extern _Thread_local struct tt_stats tt_stats;
+
+extern int tt_init(size_t mb);
+extern void tt_destroy(void);
+extern void tt_clear(void);
+extern int tt_probe(uint64_t key, struct tt_entry *restrict out);
+extern void tt_store(uint64_t key, move m, int score, int depth, int bound);
+extern void tt_stats_print(FILE *os);
+
+force_inline static void tt_prefetch(uint64_t key) {
+    if (tt.buckets) {
+	tt_stats.prefetch_key = key;
+	++tt_stats.prefetches;
+	__builtin_prefetch(&tt.buckets[key & tt.mask]);
+    }
+}
+
+#endif // TT__H_
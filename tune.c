@@ -0,0 +1,644 @@
+#define _GNU_SOURCE
+#include "tune.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "position.h"
+#include "movegen.h"
+#include "search.h"
+#include "stack.h"
+#include "eval.h"
+#include "pawns.h"
+#include "psqt.h"
+#include "weights.h"
+#include "material.h"
+#include "endgame.h"
+#include "mobility.h"
+
+// Every tuned weight has a middlegame and an endgame value at the same index
+// of `mg' and `eg'.  The eval is linear in them, apart from the choice of
+// endgame scale factor by which side is ahead:
+//   eval = sum(coef[i] * (mg[i] * phase + eg[i] * scale * (PHASE_MAX - phase))) / PHASE_MAX
+enum {
+    P_VALUE    = 0,                      // [type], no king
+    P_PSQT     = P_VALUE + 5,            // [type][sq]
+    P_PASSED   = P_PSQT + NPIECES * 64,  // [relative rank]
+    P_DOUBLED  = P_PASSED + 8,
+    P_ISOLATED,
+    P_BACKWARD,
+    P_BISHOP_PAIR,
+    P_KNIGHT_PAWNS,
+    P_ROOK_PAWNS,
+    P_MOBILITY,                          // [type], knight to queen
+    P_KING_ATTACK = P_MOBILITY + NMOBILE, // [type], knight to queen
+    NPARAMS = P_KING_ATTACK + NMOBILE,
+};
+
+// Quiet labelled position.  Pieces are stored as `pc << 6 | sq', the other
+// terms as the white minus black pawn, material and mobility counts, in
+// parameter order from P_PASSED.  Positions handled by an endgame evaluator
+// don't depend on the weights and are left out.
+#define NTERMS (NPARAMS - P_PASSED)
+struct tune_entry {
+    float    result; // 1 = white won, 0.5 = draw, 0 = black won
+    uint8_t  phase;
+    uint8_t  scale[2];
+    uint8_t  npieces;
+    int8_t   terms[NTERMS];
+    uint16_t pieces[32];
+};
+
+struct tune_data {
+    struct tune_entry *entries;
+    size_t n;
+    size_t cap;
+};
+
+struct worker {
+    pthread_t thread;
+    int started;
+    // loading
+    const char *begin;
+    const char *end;
+    struct tune_data data;
+    size_t skipped;
+    // error and gradient over entries [lo, hi)
+    const struct tune_entry *entries;
+    size_t lo;
+    size_t hi;
+    const double *mg;
+    const double *eg;
+    double k;
+    int gradient;
+    double error;
+    _Alignas(64) double grad_mg[NPARAMS];
+    double grad_eg[NPARAMS];
+};
+
+static double elapsed(const struct timespec *begin) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (now.tv_sec - begin->tv_sec) + (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+// calloc() doesn't honour the alignment of `grad_mg'
+static struct worker *workers_alloc(int nthreads) {
+    const size_t size = ((nthreads * sizeof(struct worker)) + 63) & ~(size_t)63;
+    struct worker *workers = aligned_alloc(64, size);
+    if (workers) {
+	memset(workers, 0, size);
+    }
+    return workers;
+}
+
+static void run_workers(struct worker *workers, int nthreads, void *(*fn)(void *)) {
+    int i;
+    for (i = 0; i < nthreads; ++i) {
+	workers[i].started = pthread_create(&workers[i].thread, 0, fn, &workers[i]) == 0;
+	if (!workers[i].started) {
+	    // run it here rather than give up on the whole pass
+	    fn(&workers[i]);
+	}
+    }
+    for (i = 0; i < nthreads; ++i) {
+	if (workers[i].started) {
+	    pthread_join(workers[i].thread, 0);
+	}
+    }
+}
+
+// result from the rest of an EPD line, -1 if there isn't one
+static double parse_result(const char *s, const char *end) {
+    const char *p;
+    for (p = s; p < end; ++p) {
+	if (end - p >= 7 && strncmp(p, "1/2-1/2", 7) == 0) {
+	    return 0.5;
+	} else if (end - p >= 3 && strncmp(p, "1-0", 3) == 0) {
+	    return 1.0;
+	} else if (end - p >= 3 && strncmp(p, "0-1", 3) == 0) {
+	    return 0.0;
+	} else if (*p == '[') {
+	    return atof(p + 1);
+	}
+    }
+    return -1;
+}
+
+static int tune_entry_from_line(struct tune_entry *restrict e, const char *line, const char *end) {
+    char fen[128];
+    const char *p = line;
+    size_t len;
+    int fields = 0;
+    int i;
+    int sq;
+    uint64_t pcs;
+    double result;
+    struct position pos;
+    struct position leaf;
+    struct savepos sp;
+    struct frame *f;
+    struct pawn_trace trace;
+    struct material_trace mtrace;
+    struct mobility_trace atrace;
+    struct attack_info attacks;
+    const struct material_entry *material;
+
+    // board, side, castling, en passant; the move counters don't matter here
+    while (p < end && fields < 4) {
+	while (p < end && *p != ' ') {
+	    ++p;
+	}
+	if (++fields < 4) {
+	    ++p;
+	}
+    }
+    len = p - line;
+    if (fields < 4 || len + sizeof(" 0 1") > sizeof(fen)) {
+	return 1;
+    }
+    memcpy(fen, line, len);
+    strcpy(fen + len, " 0 1");
+    result = parse_result(p, end);
+    if (result < 0 || result > 1 || position_from_fen(&pos, fen) != 0 || validate_position(&pos) != 0) {
+	return 2;
+    }
+
+    // resolve captures so the weights are fit to positions the static eval
+    // will actually see
+    f = searchstack_reset(&thread_stack, &pos);
+    qsearch(&thread_stack.pos[0], f, NEG_INFINITI, INFINITI, pos.wtm == WHITE, 0);
+    memcpy(&leaf, &pos, sizeof(leaf));
+    for (i = 0; i < f->npv; ++i) {
+	make_move(&leaf, &sp, f->pv[i]);
+    }
+
+    material = material_probe(&leaf);
+    if (material->endgame != EG_NONE) {
+	return 3;
+    }
+    e->result = result;
+    e->phase = material->phase;
+    for (i = WHITE; i <= BLACK; ++i) {
+	e->scale[i] = material->scale[i];
+	if (material->scaling != SF_NONE) {
+	    sq = scalers[material->scaling](&leaf, i);
+	    e->scale[i] = sq < e->scale[i] ? sq : e->scale[i];
+	}
+    }
+    e->npieces = 0;
+    pcs = leaf.side[WHITE] | leaf.side[BLACK];
+    while (pcs) {
+	sq = lsb(pcs);
+	e->pieces[e->npieces++] = leaf.sqtopc[sq] << 6 | sq;
+	clear_lsb(pcs);
+    }
+    pawn_trace(&leaf, &trace);
+    for (i = 0; i < 8; ++i) {
+	e->terms[i] = trace.passed[WHITE][i] - trace.passed[BLACK][i];
+    }
+    e->terms[P_DOUBLED - P_PASSED] = trace.doubled[WHITE] - trace.doubled[BLACK];
+    e->terms[P_ISOLATED - P_PASSED] = trace.isolated[WHITE] - trace.isolated[BLACK];
+    e->terms[P_BACKWARD - P_PASSED] = trace.backward[WHITE] - trace.backward[BLACK];
+    material_trace(&leaf, &mtrace);
+    e->terms[P_BISHOP_PAIR - P_PASSED] = mtrace.bishop_pair;
+    e->terms[P_KNIGHT_PAWNS - P_PASSED] = mtrace.knight_pawns;
+    e->terms[P_ROOK_PAWNS - P_PASSED] = mtrace.rook_pawns;
+    evaluate_mobility(&leaf, pawn_probe(&leaf), &attacks, &atrace);
+    for (i = 0; i < NMOBILE; ++i) {
+	e->terms[P_MOBILITY + i - P_PASSED] = atrace.mobility[i];
+	e->terms[P_KING_ATTACK + i - P_PASSED] = atrace.king_attack[i];
+    }
+    return 0;
+}
+
+static void *load_worker(void *arg) {
+    struct worker *w = arg;
+    const char *line = w->begin;
+    const char *eol;
+    struct tune_data *d = &w->data;
+    void *p;
+    while (line < w->end) {
+	eol = memchr(line, '\n', w->end - line);
+	eol = eol ? eol : w->end;
+	if (d->n == d->cap) {
+	    d->cap = d->cap ? 2 * d->cap : 4096;
+	    p = realloc(d->entries, d->cap * sizeof(d->entries[0]));
+	    if (!p) {
+		break;
+	    }
+	    d->entries = p;
+	}
+	if (eol - line > 1 && tune_entry_from_line(&d->entries[d->n], line, eol) == 0) {
+	    ++d->n;
+	} else if (eol != line) {
+	    ++w->skipped;
+	}
+	line = eol + 1;
+    }
+    return 0;
+}
+
+static int load_epd(const char *path, int nthreads, struct tune_data *out) {
+    struct worker *workers;
+    struct stat st;
+    struct timespec begin;
+    const char *map;
+    const char *p;
+    size_t skipped = 0;
+    size_t size;
+    int fd;
+    int i;
+
+    memset(out, 0, sizeof(*out));
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+	perror(path);
+	return 1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+	close(fd);
+	return 2;
+    }
+    size = st.st_size;
+    map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	return 3;
+    }
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+    workers = workers_alloc(nthreads);
+    if (!workers) {
+	munmap((void *)map, size);
+	return 4;
+    }
+
+    // split on line boundaries
+    clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+    p = map;
+    for (i = 0; i < nthreads; ++i) {
+	workers[i].begin = p;
+	p = i == nthreads - 1 ? map + size : map + size * (i + 1) / nthreads;
+	while (p < map + size && p > workers[i].begin && p[-1] != '\n') {
+	    ++p;
+	}
+	workers[i].end = p < workers[i].begin ? workers[i].begin : p;
+	p = workers[i].end;
+    }
+    run_workers(workers, nthreads, &load_worker);
+
+    for (i = 0; i < nthreads; ++i) {
+	out->n += workers[i].data.n;
+	skipped += workers[i].skipped;
+    }
+    out->entries = malloc((out->n ? out->n : 1) * sizeof(out->entries[0]));
+    if (out->entries) {
+	out->cap = out->n;
+	out->n = 0;
+	for (i = 0; i < nthreads; ++i) {
+	    if (workers[i].data.n == 0) {
+		continue;
+	    }
+	    memcpy(&out->entries[out->n], workers[i].data.entries,
+		   workers[i].data.n * sizeof(out->entries[0]));
+	    out->n += workers[i].data.n;
+	}
+    }
+    for (i = 0; i < nthreads; ++i) {
+	free(workers[i].data.entries);
+    }
+    free(workers);
+    munmap((void *)map, size);
+    if (!out->entries) {
+	return 5;
+    }
+
+    printf("Loaded %zu positions (%zu lines skipped) in %.1f seconds, %.0f positions/sec/thread, %zu bytes each\n",
+	   out->n, skipped, elapsed(&begin), (out->n + skipped) / elapsed(&begin) / nthreads,
+	   sizeof(out->entries[0]));
+    return 0;
+}
+
+static force_inline double entry_eval(const struct tune_entry *restrict e, const double *restrict mg, const double *restrict eg,
+				       double *restrict scale) {
+    double smg = 0;
+    double seg = 0;
+    int i;
+    int pc;
+    int sq;
+    int type;
+    int sign;
+    for (i = 0; i < e->npieces; ++i) {
+	pc = e->pieces[i] >> 6;
+	sq = e->pieces[i] & 63;
+	type = pc % NPIECES;
+	sign = PIECECOLOR(pc) == WHITE ? 1 : -1;
+	sq = PIECECOLOR(pc) == WHITE ? sq : sq ^ 56;
+	if (type != KING) {
+	    smg += sign * mg[P_VALUE + type];
+	    seg += sign * eg[P_VALUE + type];
+	}
+	smg += sign * mg[P_PSQT + type * 64 + sq];
+	seg += sign * eg[P_PSQT + type * 64 + sq];
+    }
+    for (i = 0; i < NTERMS; ++i) {
+	smg += e->terms[i] * mg[P_PASSED + i];
+	seg += e->terms[i] * eg[P_PASSED + i];
+    }
+    *scale = (double)e->scale[seg > 0 ? WHITE : BLACK] / SCALE_NORMAL;
+    return (smg * e->phase + seg * *scale * (PHASE_MAX - e->phase)) / PHASE_MAX;
+}
+
+static force_inline double sigmoid(double k, double score) {
+    return 1.0 / (1.0 + pow(10.0, -k * score / 400.0));
+}
+
+static void *error_worker(void *arg) {
+    struct worker *w = arg;
+    const struct tune_entry *e;
+    size_t i;
+    int j;
+    int pc;
+    int sq;
+    int type;
+    int sign;
+    double s;
+    double err;
+    double g;
+    double gmg;
+    double geg;
+    double scale;
+
+    w->error = 0;
+    if (w->gradient) {
+	memset(w->grad_mg, 0, sizeof(w->grad_mg));
+	memset(w->grad_eg, 0, sizeof(w->grad_eg));
+    }
+    for (i = w->lo; i < w->hi; ++i) {
+	e = &w->entries[i];
+	s = sigmoid(w->k, entry_eval(e, w->mg, w->eg, &scale));
+	err = e->result - s;
+	w->error += err * err;
+	if (!w->gradient) {
+	    continue;
+	}
+	// d(err^2)/d(eval), then split between the mg and eg weights by phase
+	g = -2.0 * err * s * (1.0 - s) * w->k * M_LN10 / 400.0;
+	gmg = g * e->phase / PHASE_MAX;
+	geg = g * scale * (PHASE_MAX - e->phase) / PHASE_MAX;
+	for (j = 0; j < e->npieces; ++j) {
+	    pc = e->pieces[j] >> 6;
+	    sq = e->pieces[j] & 63;
+	    type = pc % NPIECES;
+	    sign = PIECECOLOR(pc) == WHITE ? 1 : -1;
+	    sq = PIECECOLOR(pc) == WHITE ? sq : sq ^ 56;
+	    if (type != KING) {
+		w->grad_mg[P_VALUE + type] += sign * gmg;
+		w->grad_eg[P_VALUE + type] += sign * geg;
+	    }
+	    w->grad_mg[P_PSQT + type * 64 + sq] += sign * gmg;
+	    w->grad_eg[P_PSQT + type * 64 + sq] += sign * geg;
+	}
+	for (j = 0; j < NTERMS; ++j) {
+	    w->grad_mg[P_PASSED + j] += e->terms[j] * gmg;
+	    w->grad_eg[P_PASSED + j] += e->terms[j] * geg;
+	}
+    }
+    return 0;
+}
+
+// mean squared error, and its gradient in `grad_mg'/`grad_eg' if given
+static double tune_error(struct worker *workers, int nthreads, const struct tune_data *d,
+			 const double *mg, const double *eg, double k,
+			 double *restrict grad_mg, double *restrict grad_eg) {
+    double error = 0;
+    int i;
+    int j;
+    for (i = 0; i < nthreads; ++i) {
+	workers[i].entries = d->entries;
+	workers[i].lo = d->n * i / nthreads;
+	workers[i].hi = d->n * (i + 1) / nthreads;
+	workers[i].mg = mg;
+	workers[i].eg = eg;
+	workers[i].k = k;
+	workers[i].gradient = grad_mg != 0;
+    }
+    run_workers(workers, nthreads, &error_worker);
+    if (grad_mg) {
+	memset(grad_mg, 0, NPARAMS * sizeof(grad_mg[0]));
+	memset(grad_eg, 0, NPARAMS * sizeof(grad_eg[0]));
+    }
+    for (i = 0; i < nthreads; ++i) {
+	error += workers[i].error;
+	for (j = 0; grad_mg && j < NPARAMS; ++j) {
+	    grad_mg[j] += workers[i].grad_mg[j] / d->n;
+	    grad_eg[j] += workers[i].grad_eg[j] / d->n;
+	}
+    }
+    return error / d->n;
+}
+
+// the K that best maps the current eval onto the results, by golden section
+static double fit_k(struct worker *workers, int nthreads, const struct tune_data *d,
+		    const double *mg, const double *eg) {
+    const double ratio = (sqrt(5.0) - 1) / 2;
+    double a = 0.1;
+    double b = 3.0;
+    double c = b - ratio * (b - a);
+    double e = a + ratio * (b - a);
+    double fc = tune_error(workers, nthreads, d, mg, eg, c, 0, 0);
+    double fe = tune_error(workers, nthreads, d, mg, eg, e, 0, 0);
+    while (b - a > 0.001) {
+	if (fc < fe) {
+	    b = e; e = c; fe = fc;
+	    c = b - ratio * (b - a);
+	    fc = tune_error(workers, nthreads, d, mg, eg, c, 0, 0);
+	} else {
+	    a = c; c = e; fc = fe;
+	    e = a + ratio * (b - a);
+	    fe = tune_error(workers, nthreads, d, mg, eg, e, 0, 0);
+	}
+    }
+    return (a + b) / 2;
+}
+
+static void weights_to_params(double *mg, double *eg) {
+    int type;
+    int sq;
+    int i;
+    for (type = KNIGHT; type < KING; ++type) {
+	mg[P_VALUE + type] = piece_value_mg[type];
+	eg[P_VALUE + type] = piece_value_eg[type];
+    }
+    for (type = KNIGHT; type <= KING; ++type) {
+	for (sq = A1; sq <= H8; ++sq) {
+	    mg[P_PSQT + type * 64 + sq] = psqt_mg[type][sq];
+	    eg[P_PSQT + type * 64 + sq] = psqt_eg[type][sq];
+	}
+    }
+    for (i = 0; i < 8; ++i) {
+	mg[P_PASSED + i] = passed_pawn_mg[i];
+	eg[P_PASSED + i] = passed_pawn_eg[i];
+    }
+    mg[P_DOUBLED] = doubled_pawn_mg;
+    eg[P_DOUBLED] = doubled_pawn_eg;
+    mg[P_ISOLATED] = isolated_pawn_mg;
+    eg[P_ISOLATED] = isolated_pawn_eg;
+    mg[P_BACKWARD] = backward_pawn_mg;
+    eg[P_BACKWARD] = backward_pawn_eg;
+    mg[P_BISHOP_PAIR] = bishop_pair_mg;
+    eg[P_BISHOP_PAIR] = bishop_pair_eg;
+    mg[P_KNIGHT_PAWNS] = knight_pawns_mg;
+    eg[P_KNIGHT_PAWNS] = knight_pawns_eg;
+    mg[P_ROOK_PAWNS] = rook_pawns_mg;
+    eg[P_ROOK_PAWNS] = rook_pawns_eg;
+    for (i = 0; i < NMOBILE; ++i) {
+	mg[P_MOBILITY + i] = mobility_mg[i];
+	eg[P_MOBILITY + i] = mobility_eg[i];
+	mg[P_KING_ATTACK + i] = king_attack_mg[i];
+	eg[P_KING_ATTACK + i] = king_attack_eg[i];
+    }
+}
+
+#define R(x) ((int)lround(x))
+
+static void write_psqt(FILE *os, const char *name, const double *w) {
+    static const char *names[NPIECES] = {
+	[KNIGHT] = "KNIGHT", [BISHOP] = "BISHOP", [ROOK] = "ROOK",
+	[QUEEN] = "QUEEN", [PAWN] = "PAWN", [KING] = "KING",
+    };
+    int type;
+    int sq;
+    fprintf(os, "int16_t %s[NPIECES][64] = {\n", name);
+    for (type = KNIGHT; type <= KING; ++type) {
+	fprintf(os, "    [%s] = {\n", names[type]);
+	for (sq = A1; sq <= H8; ++sq) {
+	    fprintf(os, "%s%4d,%s", sq % 8 == 0 ? "        " : " ",
+		    R(w[P_PSQT + type * 64 + sq]), sq % 8 == 7 ? "\n" : "");
+	}
+	fprintf(os, "    },\n");
+    }
+    fprintf(os, "};\n");
+}
+
+static void write_array(FILE *os, const char *name, const double *w, int n) {
+    int i;
+    fprintf(os, "int16_t %s[%d] = {", name, n);
+    for (i = 0; i < n; ++i) {
+	fprintf(os, " %d%s", R(w[i]), i == n - 1 ? " " : ",");
+    }
+    fprintf(os, "};\n");
+}
+
+static int write_weights(const char *path, const double *mg, const double *eg) {
+    FILE *os = fopen(path, "w");
+    if (!os) {
+	perror(path);
+	return 1;
+    }
+    fprintf(os, "#include \"weights.h\"\n\n");
+    fprintf(os, "// Generated by `chess tune'.\n");
+    fprintf(os, "// Tables are laid out a1..h8, so rank 1 is the first row and white plays \"up\".\n\n");
+    fprintf(os, "int16_t piece_value_mg[NPIECES] = { [KNIGHT] = %d, [BISHOP] = %d, [ROOK] = %d, [QUEEN] = %d, [PAWN] = %d, [KING] = 0 };\n",
+	    R(mg[P_VALUE + KNIGHT]), R(mg[P_VALUE + BISHOP]), R(mg[P_VALUE + ROOK]), R(mg[P_VALUE + QUEEN]), R(mg[P_VALUE + PAWN]));
+    fprintf(os, "int16_t piece_value_eg[NPIECES] = { [KNIGHT] = %d, [BISHOP] = %d, [ROOK] = %d, [QUEEN] = %d, [PAWN] = %d, [KING] = 0 };\n\n",
+	    R(eg[P_VALUE + KNIGHT]), R(eg[P_VALUE + BISHOP]), R(eg[P_VALUE + ROOK]), R(eg[P_VALUE + QUEEN]), R(eg[P_VALUE + PAWN]));
+    write_psqt(os, "psqt_mg", mg);
+    fprintf(os, "\n");
+    write_psqt(os, "psqt_eg", eg);
+    fprintf(os, "\n");
+    write_array(os, "passed_pawn_mg", &mg[P_PASSED], 8);
+    write_array(os, "passed_pawn_eg", &eg[P_PASSED], 8);
+    fprintf(os, "int16_t doubled_pawn_mg = %d;\n", R(mg[P_DOUBLED]));
+    fprintf(os, "int16_t doubled_pawn_eg = %d;\n", R(eg[P_DOUBLED]));
+    fprintf(os, "int16_t isolated_pawn_mg = %d;\n", R(mg[P_ISOLATED]));
+    fprintf(os, "int16_t isolated_pawn_eg = %d;\n", R(eg[P_ISOLATED]));
+    fprintf(os, "int16_t backward_pawn_mg = %d;\n", R(mg[P_BACKWARD]));
+    fprintf(os, "int16_t backward_pawn_eg = %d;\n", R(eg[P_BACKWARD]));
+    fprintf(os, "int16_t bishop_pair_mg = %d;\n", R(mg[P_BISHOP_PAIR]));
+    fprintf(os, "int16_t bishop_pair_eg = %d;\n", R(eg[P_BISHOP_PAIR]));
+    fprintf(os, "int16_t knight_pawns_mg = %d;\n", R(mg[P_KNIGHT_PAWNS]));
+    fprintf(os, "int16_t knight_pawns_eg = %d;\n", R(eg[P_KNIGHT_PAWNS]));
+    fprintf(os, "int16_t rook_pawns_mg = %d;\n", R(mg[P_ROOK_PAWNS]));
+    fprintf(os, "int16_t rook_pawns_eg = %d;\n", R(eg[P_ROOK_PAWNS]));
+    write_array(os, "mobility_mg", &mg[P_MOBILITY], NMOBILE);
+    write_array(os, "mobility_eg", &eg[P_MOBILITY], NMOBILE);
+    write_array(os, "king_attack_mg", &mg[P_KING_ATTACK], NMOBILE);
+    write_array(os, "king_attack_eg", &eg[P_KING_ATTACK], NMOBILE);
+    return fclose(os) == 0 ? 0 : 2;
+}
+
+/*extern*/ int tune(const struct tune_options *opts) {
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    const int nthreads = opts->threads > 0 ? opts->threads : 1;
+    struct tune_data data;
+    struct worker *workers;
+    struct timespec begin;
+    double mg[NPARAMS], eg[NPARAMS];
+    double grad_mg[NPARAMS], grad_eg[NPARAMS];
+    double m_mg[NPARAMS] = {0}, m_eg[NPARAMS] = {0};
+    double v_mg[NPARAMS] = {0}, v_eg[NPARAMS] = {0};
+    double k;
+    double error;
+    double secs = 0;
+    double c1;
+    double c2;
+    int iter;
+    int i;
+    int rval;
+
+    if (load_epd(opts->epd, nthreads, &data) != 0 || data.n == 0) {
+	fprintf(stderr, "Unable to load any positions from '%s'\n", opts->epd);
+	free(data.entries);
+	return 1;
+    }
+    workers = workers_alloc(nthreads);
+    if (!workers) {
+	free(data.entries);
+	return 2;
+    }
+
+    weights_to_params(mg, eg);
+    k = fit_k(workers, nthreads, &data, mg, eg);
+    error = tune_error(workers, nthreads, &data, mg, eg, k, 0, 0);
+    printf("K = %.3f, initial error = %.6f, tuning %d weights on %d threads\n", k, error, 2 * NPARAMS, nthreads);
+
+    for (iter = 1; iter <= opts->iterations; ++iter) {
+	clock_gettime(CLOCK_MONOTONIC_RAW, &begin);
+	error = tune_error(workers, nthreads, &data, mg, eg, k, grad_mg, grad_eg);
+	secs += elapsed(&begin);
+
+	// Adam, the gradients of rarely seen weights (e.g. pawns on the 7th)
+	// are orders of magnitude smaller than the material ones
+	c1 = 1 - pow(beta1, iter);
+	c2 = 1 - pow(beta2, iter);
+	for (i = 0; i < NPARAMS; ++i) {
+	    m_mg[i] = beta1 * m_mg[i] + (1 - beta1) * grad_mg[i];
+	    m_eg[i] = beta1 * m_eg[i] + (1 - beta1) * grad_eg[i];
+	    v_mg[i] = beta2 * v_mg[i] + (1 - beta2) * grad_mg[i] * grad_mg[i];
+	    v_eg[i] = beta2 * v_eg[i] + (1 - beta2) * grad_eg[i] * grad_eg[i];
+	    mg[i] -= opts->rate * (m_mg[i] / c1) / (sqrt(v_mg[i] / c2) + 1e-8);
+	    eg[i] -= opts->rate * (m_eg[i] / c1) / (sqrt(v_eg[i] / c2) + 1e-8);
+	}
+
+	if (iter % 50 == 0 || iter == opts->iterations) {
+	    printf("iteration %d, error = %.6f, %.0f positions/sec/thread\n",
+		   iter, error, (double)data.n * iter / secs / nthreads);
+	}
+    }
+    error = tune_error(workers, nthreads, &data, mg, eg, k, 0, 0);
+    printf("final error = %.6f, writing weights to '%s'\n", error, opts->output);
+
+    rval = write_weights(opts->output, mg, eg);
+    free(workers);
+    free(data.entries);
+    return rval;
+}
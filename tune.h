@@ -0,0 +1,31 @@
+#ifndef TUNE__H_
+#define TUNE__H_
+
+#include <stddef.h>
+
+// Texel tuning of the hand written eval weights in weights.c.
+//
+// Every labelled position in the EPD file is resolved with qsearch() and the
+// quiet position at the end of the PV is kept in a compact array.  Weights
+// are then fit by minimising the squared error between the game result and
+// sigmoid(K * eval) over all positions, with the gradient computed across
+// `threads' threads.  The result is written out as a replacement weights.c.
+//
+// EPD lines are a FEN (the move counters are optional) followed by the result
+// of the game as "1-0", "0-1", "1/2-1/2" or a number in [0, 1] from white's
+// point of view, e.g. `... w - - c9 "1/2-1/2";' or `... w - - [0.5]'.
+struct tune_options {
+    const char *epd;
+    const char *output;
+    int threads;
+    int iterations;
+    double rate;
+};
+
+#define DEFAULT_TUNE_OUTPUT "weights_tuned.c"
+#define DEFAULT_TUNE_ITERATIONS 500
+#define DEFAULT_TUNE_RATE 1.0 // Adam step size in centipawns
+
+extern int tune(const struct tune_options *opts);
+
+#endif // TUNE__H_
@@ -0,0 +1,151 @@
+#include "weights.h"
+
+// Tables are laid out a1..h8, so rank 1 is the first row and white plays "up".
+
+int16_t piece_value_mg[NPIECES] = { [KNIGHT] = 337, [BISHOP] = 365, [ROOK] = 477, [QUEEN] = 1025, [PAWN] = 82, [KING] = 0 };
+int16_t piece_value_eg[NPIECES] = { [KNIGHT] = 281, [BISHOP] = 297, [ROOK] = 512, [QUEEN] = 936, [PAWN] = 94, [KING] = 0 };
+
+int16_t psqt_mg[NPIECES][64] = {
+    [KNIGHT] = {
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+         -40,  -20,    0,    5,    5,    0,  -20,  -40,
+         -30,    5,   10,   15,   15,   10,    5,  -30,
+         -30,    0,   15,   20,   20,   15,    0,  -30,
+         -30,    5,   15,   20,   20,   15,    5,  -30,
+         -30,    0,   10,   15,   15,   10,    0,  -30,
+         -40,  -20,    0,    0,    0,    0,  -20,  -40,
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+    },
+    [BISHOP] = {
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+         -10,    5,    0,    0,    0,    0,    5,  -10,
+         -10,   10,   10,   10,   10,   10,   10,  -10,
+         -10,    0,   10,   10,   10,   10,    0,  -10,
+         -10,    5,    5,   10,   10,    5,    5,  -10,
+         -10,    0,    5,   10,   10,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+    },
+    [ROOK] = {
+           0,    0,    0,    5,    5,    0,    0,    0,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+           5,   10,   10,   10,   10,   10,   10,    5,
+           0,    0,    0,    0,    0,    0,    0,    0,
+    },
+    [QUEEN] = {
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+         -10,    0,    5,    0,    0,    0,    0,  -10,
+         -10,    5,    5,    5,    5,    5,    0,  -10,
+           0,    0,    5,    5,    5,    5,    0,   -5,
+          -5,    0,    5,    5,    5,    5,    0,   -5,
+         -10,    0,    5,    5,    5,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+    },
+    [PAWN] = {
+           0,    0,    0,    0,    0,    0,    0,    0,
+           5,   10,   10,  -20,  -20,   10,   10,    5,
+           5,   -5,  -10,    0,    0,  -10,   -5,    5,
+           0,    0,    0,   20,   20,    0,    0,    0,
+           5,    5,   10,   25,   25,   10,    5,    5,
+          10,   10,   20,   30,   30,   20,   10,   10,
+          50,   50,   50,   50,   50,   50,   50,   50,
+           0,    0,    0,    0,    0,    0,    0,    0,
+    },
+    [KING] = {
+          20,   30,   10,    0,    0,   10,   30,   20,
+          20,   20,    0,    0,    0,    0,   20,   20,
+         -10,  -20,  -20,  -20,  -20,  -20,  -20,  -10,
+         -20,  -30,  -30,  -40,  -40,  -30,  -30,  -20,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+         -30,  -40,  -40,  -50,  -50,  -40,  -40,  -30,
+    },
+};
+
+int16_t psqt_eg[NPIECES][64] = {
+    [KNIGHT] = {
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+         -40,  -20,    0,    5,    5,    0,  -20,  -40,
+         -30,    5,   10,   15,   15,   10,    5,  -30,
+         -30,    0,   15,   20,   20,   15,    0,  -30,
+         -30,    5,   15,   20,   20,   15,    5,  -30,
+         -30,    0,   10,   15,   15,   10,    0,  -30,
+         -40,  -20,    0,    0,    0,    0,  -20,  -40,
+         -50,  -40,  -30,  -30,  -30,  -30,  -40,  -50,
+    },
+    [BISHOP] = {
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+         -10,    5,    0,    0,    0,    0,    5,  -10,
+         -10,   10,   10,   10,   10,   10,   10,  -10,
+         -10,    0,   10,   10,   10,   10,    0,  -10,
+         -10,    5,    5,   10,   10,    5,    5,  -10,
+         -10,    0,    5,   10,   10,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,  -10,  -10,  -10,  -10,  -20,
+    },
+    [ROOK] = {
+           0,    0,    0,    5,    5,    0,    0,    0,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+          -5,    0,    0,    0,    0,    0,    0,   -5,
+           5,   10,   10,   10,   10,   10,   10,    5,
+           0,    0,    0,    0,    0,    0,    0,    0,
+    },
+    [QUEEN] = {
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+         -10,    0,    5,    0,    0,    0,    0,  -10,
+         -10,    5,    5,    5,    5,    5,    0,  -10,
+           0,    0,    5,    5,    5,    5,    0,   -5,
+          -5,    0,    5,    5,    5,    5,    0,   -5,
+         -10,    0,    5,    5,    5,    5,    0,  -10,
+         -10,    0,    0,    0,    0,    0,    0,  -10,
+         -20,  -10,  -10,   -5,   -5,  -10,  -10,  -20,
+    },
+    [PAWN] = {
+           0,    0,    0,    0,    0,    0,    0,    0,
+           5,    5,    5,    5,    5,    5,    5,    5,
+          10,   10,   10,   10,   10,   10,   10,   10,
+          20,   20,   20,   20,   20,   20,   20,   20,
+          30,   30,   30,   30,   30,   30,   30,   30,
+          50,   50,   50,   50,   50,   50,   50,   50,
+          80,   80,   80,   80,   80,   80,   80,   80,
+           0,    0,    0,    0,    0,    0,    0,    0,
+    },
+    [KING] = {
+         -50,  -30,  -30,  -30,  -30,  -30,  -30,  -50,
+         -30,  -30,    0,    0,    0,    0,  -30,  -30,
+         -30,  -10,   20,   30,   30,   20,  -10,  -30,
+         -30,  -10,   30,   40,   40,   30,  -10,  -30,
+         -30,  -10,   30,   40,   40,   30,  -10,  -30,
+         -30,  -10,   20,   30,   30,   20,  -10,  -30,
+         -30,  -20,  -10,    0,    0,  -10,  -20,  -30,
+         -50,  -40,  -30,  -20,  -20,  -30,  -40,  -50,
+    },
+};
+
+int16_t passed_pawn_mg[8] = { 0,  5, 10, 15, 25,  40,  60, 0 };
+int16_t passed_pawn_eg[8] = { 0, 10, 15, 25, 45,  70, 110, 0 };
+int16_t doubled_pawn_mg = -10;
+int16_t doubled_pawn_eg = -20;
+int16_t isolated_pawn_mg = -10;
+int16_t isolated_pawn_eg = -15;
+int16_t backward_pawn_mg = -8;
+int16_t backward_pawn_eg = -10;
+int16_t bishop_pair_mg = 25;
+int16_t bishop_pair_eg = 45;
+int16_t knight_pawns_mg = 4;
+int16_t knight_pawns_eg = 4;
+int16_t rook_pawns_mg = -6;
+int16_t rook_pawns_eg = -6;
+int16_t mobility_mg[4] = { 4, 5, 2, 1 };
+int16_t mobility_eg[4] = { 4, 5, 4, 2 };
+int16_t king_attack_mg[4] = { 6, 5, 7, 10 };
+int16_t king_attack_eg[4] = { 1, 1, 1, 1 };
@@ -0,0 +1,39 @@
+#ifndef WEIGHTS__H_
+#define WEIGHTS__H_
+
+#include <stdint.h>
+#include "move.h"
+
+// Evaluation weights in centipawns, indexed by piece type (see `enum { KNIGHT, ... }').
+// Piece-square tables are from white's point of view, a1 = 0 ... h8 = 63; black
+// uses the same tables flipped vertically.
+extern int16_t piece_value_mg[NPIECES];
+extern int16_t piece_value_eg[NPIECES];
+extern int16_t psqt_mg[NPIECES][64];
+extern int16_t psqt_eg[NPIECES][64];
+
+// pawn structure, per pawn; passed pawn bonus is indexed by relative rank
+extern int16_t passed_pawn_mg[8];
+extern int16_t passed_pawn_eg[8];
+extern int16_t doubled_pawn_mg;
+extern int16_t doubled_pawn_eg;
+extern int16_t isolated_pawn_mg;
+extern int16_t isolated_pawn_eg;
+extern int16_t backward_pawn_mg;
+extern int16_t backward_pawn_eg;
+
+// material imbalance, see material.c
+extern int16_t bishop_pair_mg;
+extern int16_t bishop_pair_eg;
+extern int16_t knight_pawns_mg; // per knight per own pawn above 5
+extern int16_t knight_pawns_eg;
+extern int16_t rook_pawns_mg;   // per rook per own pawn above 5
+extern int16_t rook_pawns_eg;
+
+// piece activity, see mobility.c; indexed by piece type KNIGHT..QUEEN
+extern int16_t mobility_mg[4];     // per safe square reachable
+extern int16_t mobility_eg[4];
+extern int16_t king_attack_mg[4];  // per square attacked next to the enemy king
+extern int16_t king_attack_eg[4];
+
+#endif // WEIGHTS__H_
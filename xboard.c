@@ -9,6 +9,13 @@
 #include "movegen.h"
 #include "eval.h"
 #include "search.h"
+#include "tt.h"
+#include "nnue.h"
+#include "stack.h"
+#include "mcts.h"
+#include "bitbase.h"
+#include "syzygy.h"
+#include "polyglot.h"
 
 enum {
     XBOARD_SETUP,
@@ -24,6 +31,9 @@ struct xboard_settings {
     struct position pos;
     struct savepos sp;
     move moves[MAX_MOVES];
+    // hashes of the game positions before `pos', oldest first
+    uint64_t history[HISTORY_PLIES];
+    int nhistory;
 };
 // TEMP TEMP
 struct xboard_settings *g_settings = 0;
@@ -37,11 +47,25 @@ static int xboard_settings_create(struct xboard_settings *settings) {
     memset(&settings->moves[0], 0, sizeof(settings->moves[0]));
     memset(&settings->pos, 0, sizeof(settings->pos));
     memset(&settings->sp, 0, sizeof(settings->sp));
+    settings->nhistory = 0;
     // TODO: move this to a common location
     const char *starting_position = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     if (position_from_fen(&settings->pos, starting_position) != 0) {
 	return 1;
     }
+    if (tt_init(DEFAULT_HASH_MB) != 0) {
+	return 1;
+    }
+    // falls back to the hand written eval without a weights file
+    if (nnue_load(DEFAULT_NNUE_FILE) != 0) {
+	fprintf(settings->debug_output, "no nnue weights in '%s', using classical eval\n", DEFAULT_NNUE_FILE);
+    }
+    fprintf(settings->debug_output, "%d bitbases in '%s'\n", bitbase_load(DEFAULT_BITBASE_DIR),
+	    DEFAULT_BITBASE_DIR);
+    // plays without a book if there isn't one
+    if (polyglot_open(DEFAULT_BOOK_FILE) != 0) {
+	fprintf(settings->debug_output, "no opening book in '%s'\n", DEFAULT_BOOK_FILE);
+    }
     // TEMP TEMP
     g_settings = settings;
     return 0;
@@ -50,10 +74,24 @@ static int xboard_settings_destroy(struct xboard_settings *settings) {
     if (settings->debug_output) {
 	fclose(settings->debug_output);
     }
+    tt_destroy();
+    nnue_unload();
+    bitbase_unload();
+    syzygy_free();
+    polyglot_close();
     // TEMP TEMP    
     g_settings = 0;
     return 0;
 }
+static void xboard_make_move(struct xboard_settings *settings, move m) {
+    if (settings->nhistory == HISTORY_PLIES) {
+	memmove(&settings->history[0], &settings->history[1], (HISTORY_PLIES - 1) * sizeof(settings->history[0]));
+	--settings->nhistory;
+    }
+    settings->history[settings->nhistory++] = settings->pos.hash;
+    make_move(&settings->pos, &settings->sp, m);
+}
+
 static void sigh(int nsig) {
     DEBUGF("Received signal: %d\n", nsig);
 }
@@ -82,7 +120,16 @@ static int xboard_handle_input(const char *line, int len, struct xboard_settings
 	    WRITE("feature reuse=0\n");
 	    WRITE("feature analyze=0\n");
 	    WRITE("feature time=0\n");
+	    WRITE("feature egt=\"syzygy\"\n");
+	    WRITE("feature option=\"SyzygyPath -path <empty>\"\n");
+	    WRITE("feature option=\"SyzygySearch -check 0\"\n");
 	    WRITE("feature done=1\n");
+	} else if (STRNCMP(line, "option SyzygyPath=")) {
+	    DEBUGF("%d syzygy tables\n", syzygy_init(line + strlen("option SyzygyPath=")));
+	} else if (STRNCMP(line, "option SyzygySearch=")) {
+	    syzygy_search = atoi(line + strlen("option SyzygySearch=")) != 0;
+	} else if (STRNCMP(line, "egtpath syzygy ")) {
+	    DEBUGF("%d syzygy tables\n", syzygy_init(line + strlen("egtpath syzygy ")));
 	} else if (STRCMP(line, "new")) {
 	    // nop?
 	} else if (STRCMP(line, "random")) {
@@ -143,7 +190,7 @@ static int xboard_handle_input(const char *line, int len, struct xboard_settings
 		m = PROMOTION(from, to, prm);
 	    }
 
-	    make_move(&settings->pos, &settings->sp, m);
+	    xboard_make_move(settings, m);
 	} else {
 	    //printf("Error (bad move): %.*s\n", len, line);
 	    WRITE("Error (bad move): %.*s\n", len, line);
@@ -165,8 +212,22 @@ static int xboard_handle_input(const char *line, int len, struct xboard_settings
 
 	// TODO: resign logic? maybe just never resign...
 	// REVISIT(plesslie): xboard isn't detecting mate.  need to figure out what to send there
-	move mv = search(&settings->pos);
-	make_move(&settings->pos, &settings->sp, mv);
+	move mv = polyglot_pick(&settings->pos);
+	if (mv) {
+	    DEBUGF("book move %s\n", xboard_move_print(mv));
+	} else {
+#ifdef MCTS
+	    const struct mcts_options opts = {
+		.playouts = DEFAULT_MCTS_PLAYOUTS,
+		.threads = 1,
+		.pool_mb = DEFAULT_MCTS_POOL_MB,
+	    };
+	    mv = mcts_search(&settings->pos, settings->history, settings->nhistory, &opts, 0);
+#else
+	    mv = search(&settings->pos, settings->history, settings->nhistory, DEFAULT_SEARCH_DEPTH);
+#endif
+	}
+	xboard_make_move(settings, mv);
 	const char *movestr = xboard_move_print(mv);
 	WRITE("move %s\n", movestr);
 	
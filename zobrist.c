@@ -0,0 +1,67 @@
+#include "zobrist.h"
+#include "position.h"
+
+uint64_t zobrist_pcsq[EMPTY + 1][64];
+uint64_t zobrist_pawn[EMPTY + 1][64];
+uint64_t zobrist_castle[CSL_ALL + 1];
+uint64_t zobrist_ep[EP_NONE + 1];
+uint64_t zobrist_wtm;
+
+// xorshift64*, fixed seed so keys (and therefore searches) are reproducible
+static uint64_t zobrist_rand(void) {
+    static uint64_t state = 0x9e3779b97f4a7c15ull;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+// run before main() so that every position_from_fen() gets a valid key
+__attribute__((constructor)) static void zobrist_init(void) {
+    int pc;
+    int sq;
+    int i;
+    for (pc = PIECE(WHITE, KNIGHT); pc <= PIECE(BLACK, KING); ++pc) {
+	for (sq = A1; sq <= H8; ++sq) {
+	    zobrist_pcsq[pc][sq] = zobrist_rand();
+	}
+    }
+    for (i = 0; i <= CSL_ALL; ++i) {
+	zobrist_castle[i] = zobrist_rand();
+    }
+    zobrist_castle[CSL_NONE] = 0;
+    for (sq = A3; sq <= H3; ++sq) {
+	zobrist_ep[sq] = zobrist_rand();
+    }
+    for (sq = A6; sq <= H6; ++sq) {
+	zobrist_ep[sq] = zobrist_rand();
+    }
+    zobrist_wtm = zobrist_rand();
+    for (sq = A1; sq <= H8; ++sq) {
+	zobrist_pawn[PIECE(WHITE, PAWN)][sq] = zobrist_pcsq[PIECE(WHITE, PAWN)][sq];
+	zobrist_pawn[PIECE(BLACK, PAWN)][sq] = zobrist_pcsq[PIECE(BLACK, PAWN)][sq];
+    }
+}
+
+/*extern*/ uint64_t zobrist_hash(const struct position *restrict pos) {
+    uint64_t hash = 0;
+    int sq;
+    for (sq = A1; sq <= H8; ++sq) {
+	hash ^= zobrist_pcsq[pos->sqtopc[sq]][sq];
+    }
+    hash ^= zobrist_castle[pos->castle];
+    hash ^= zobrist_ep[pos->enpassant];
+    if (pos->wtm == BLACK) {
+	hash ^= zobrist_wtm;
+    }
+    return hash;
+}
+
+/*extern*/ uint64_t zobrist_pawn_hash(const struct position *restrict pos) {
+    uint64_t hash = 0;
+    int sq;
+    for (sq = A1; sq <= H8; ++sq) {
+	hash ^= zobrist_pawn[pos->sqtopc[sq]][sq];
+    }
+    return hash;
+}
@@ -0,0 +1,22 @@
+#ifndef ZOBRIST__H_
+#define ZOBRIST__H_
+
+#include <stdint.h>
+#include "move.h"
+
+// Random keys hashed into `struct position'::hash.  The `EMPTY' piece row and
+// the `EP_NONE' en passant slot are all zeros so that make_move() can xor them
+// in without branching on "was there a capture" or "is there an ep square".
+extern uint64_t zobrist_pcsq[EMPTY + 1][64];
+// same keys as `zobrist_pcsq' for pawns, zero for every other piece, so the
+// pawn-only key can be updated without checking what moved
+extern uint64_t zobrist_pawn[EMPTY + 1][64];
+extern uint64_t zobrist_castle[CSL_ALL + 1];
+extern uint64_t zobrist_ep[EP_NONE + 1];
+extern uint64_t zobrist_wtm;
+
+struct position;
+extern uint64_t zobrist_hash(const struct position *restrict pos);
+extern uint64_t zobrist_pawn_hash(const struct position *restrict pos);
+
+#endif // ZOBRIST__H_